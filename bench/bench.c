@@ -0,0 +1,999 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+/**
+  * viewbinding-bench: Throughput benchmark for the view binding generator
+  * Copyright (C) 2025- LuoYu0401 luoyu0401@139.com
+  *
+  * This program is free software: you can redistribute it and/or modify
+  * it under the terms of the GNU General Public License as published by
+  * the Free Software Foundation, either version 3 of the License, or
+  * version.
+  *
+  * This program is distributed in the hope that it will be useful,
+  * but WITHOUT ANY WARRANTY; without even the implied warranty of
+  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  * GNU General Public License for more details.
+  *
+  * You should have received a copy of the GNU General Public License
+  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+  **/
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+// Widget classes picked at random for the synthetic objects
+static const gchar *const widget_classes[] = {
+	"GtkBox",	 "GtkLabel",	   "GtkButton",	     "GtkEntry",
+	"GtkStack",	 "GtkGrid",	   "GtkToggleButton", "GtkListBox",
+	"GtkRevealer",	 "GtkSearchEntry", "GtkScrolledWindow", "GtkImage",
+	"GtkGLArea",
+};
+
+/*
+ * Class names with digits, which GtkBuilder takes for capitals, and the
+ * function its first mangling looks up for them
+ */
+static const struct {
+	const gchar *class_name;
+	const gchar *function_name;
+} digit_type_names[] = {
+	{ "GdkX11Display", "gdk_x1_1_display_get_type" },
+	{ "GdkX11Surface", "gdk_x1_1_surface_get_type" },
+	{ "GdkWin32Display", "gdk_win_32_display_get_type" },
+};
+
+typedef struct {
+	gint64 elapsed_usec;
+	gboolean success;
+} BenchRun;
+
+// Generator options of one --compare-engines configuration
+typedef struct {
+	const gchar *name;
+	const gchar *args[5];
+} EngineConfig;
+
+/*
+ * The first configuration is the baseline, every other one has to generate
+ * byte-identical files
+ */
+static const EngineConfig engine_configs[] = {
+	{ "markup", { "--engine", "markup", NULL } },
+	{ "markup-read",
+	  { "--engine", "markup", "--read-mode", "read", NULL } },
+	{ "markup-stream",
+	  { "--engine", "markup", "--read-mode", "stream", NULL } },
+	{ "markup-jobs", { "--engine", "markup", "--jobs", "4", NULL } },
+	{ "output-stream",
+	  { "--engine", "markup", "--output-mode", "stream", NULL } },
+	{ "fast", { "--engine", "fast", NULL } },
+	{ "fast-read", { "--engine", "fast", "--read-mode", "read", NULL } },
+	{ "fast-jobs", { "--engine", "fast", "--jobs", "4", NULL } },
+};
+
+static void parse_arguments(int argc, char *argv[]);
+
+static void check_arguments(const gchar *program_name);
+
+static guint64 generate_corpus(const gchar *corpus_directory);
+
+static gsize generate_ui_file(GString *output_buffer, GRand *rand,
+			      guint file_index);
+
+static void generate_object(GString *output_buffer, GRand *rand,
+			    guint file_index, guint depth, guint *objects_left,
+			    guint *signals_left);
+
+static BenchRun run_generator(const gchar *corpus_directory,
+			      const gchar *output_directory,
+			      const gchar *const *config_args);
+
+static gboolean compare_engines_on_corpus(const gchar *corpus_directory,
+					  const gchar *output_directory,
+					  guint64 corpus_bytes);
+
+static guint compare_outputs(const gchar *baseline_directory,
+			     const gchar *output_directory);
+
+static guint compare_standard_input(const gchar *corpus_directory,
+				    const gchar *baseline_directory);
+
+static gboolean run_generator_on_stdin(const gchar *file_path,
+				       const gchar *file_name,
+				       GString *output_buffer);
+
+static gboolean write_all(gint fd, const gchar *data, gsize size);
+
+static guint check_type_functions(const gchar *corpus_directory,
+				  const gchar *baseline_directory);
+
+static guint check_exclusions(const gchar *corpus_directory);
+
+static gchar *generate_fixture(const gchar *corpus_directory,
+			       const gchar *name, const gchar *content,
+			       const gchar *const *config_args);
+
+static gchar *mangle_type_name(const gchar *name);
+
+static guint count_missing_files(const gchar *directory,
+				 const gchar *other_directory);
+
+static gint compare_runs(gconstpointer a, gconstpointer b);
+
+static void print_report(GArray *runs, guint64 corpus_bytes);
+
+static void remove_directory(const gchar *path);
+
+static gchar *generator = NULL;
+static gchar *corpus_directory = NULL;
+static gint file_count = 500;
+static gint depth = 4;
+static gint objects = 50;
+static gint signals = 10;
+static gint iterations = 5;
+static gint seed = 1;
+static gboolean keep = FALSE;
+static gboolean compare_engines = FALSE;
+static gchar **generator_args = NULL;
+
+static GOptionEntry entries[] = {
+	{ "generator", 'g', 0, G_OPTION_ARG_FILENAME, &generator,
+	  "The viewbinding binary to run, defaults to the one next to this program",
+	  "PATH" },
+	{ "corpus-directory", 'c', 0, G_OPTION_ARG_FILENAME, &corpus_directory,
+	  "Where to write the synthetic UI files, defaults to a temporary directory",
+	  "DIR" },
+	{ "files", 'n', 0, G_OPTION_ARG_INT, &file_count,
+	  "The number of UI files in the corpus (default 500)", "N" },
+	{ "depth", 0, 0, G_OPTION_ARG_INT, &depth,
+	  "The maximum nesting depth of objects below the template (default 4)",
+	  "N" },
+	{ "objects", 0, 0, G_OPTION_ARG_INT, &objects,
+	  "The number of objects per file (default 50)", "N" },
+	{ "signals", 0, 0, G_OPTION_ARG_INT, &signals,
+	  "The number of signal handlers per file (default 10)", "N" },
+	{ "iterations", 'i', 0, G_OPTION_ARG_INT, &iterations,
+	  "How often the generator is run over the corpus (default 5)", "N" },
+	{ "seed", 0, 0, G_OPTION_ARG_INT, &seed,
+	  "The random seed of the corpus, equal seeds give equal corpora",
+	  "N" },
+	{ "keep", 'k', 0, G_OPTION_ARG_NONE, &keep,
+	  "Do not delete the corpus and the generated files afterwards", NULL },
+	{ "compare-engines", 0, 0, G_OPTION_ARG_NONE, &compare_engines,
+	  "Run every engine, read mode and output mode, check that they generate the same files as --engine markup and compare their throughput",
+	  NULL },
+	{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_STRING_ARRAY, &generator_args,
+	  NULL, "[-- GENERATOR-OPTIONS...]" },
+	{ NULL }
+};
+
+int main(int argc, char *argv[])
+{
+	g_autofree gchar *output_directory = NULL;
+	g_autoptr(GArray) runs = g_array_new(FALSE, FALSE, sizeof(BenchRun));
+	g_autoptr(GError) error = NULL;
+	gboolean temporary_corpus = FALSE;
+	gboolean success = TRUE;
+	guint64 corpus_bytes = 0;
+
+	parse_arguments(argc, argv);
+	check_arguments(argv[0]);
+
+	temporary_corpus = corpus_directory == NULL;
+	if (temporary_corpus) {
+		corpus_directory = g_dir_make_tmp("viewbinding-bench-XXXXXX",
+						  &error);
+		if (corpus_directory == NULL) {
+			g_printerr("Error creating corpus directory: %s\n",
+				   error->message);
+			return EXIT_FAILURE;
+		}
+	} else if (g_mkdir_with_parents(corpus_directory, 0755) != 0) {
+		g_printerr("Error: could not create corpus directory '%s'.\n",
+			   corpus_directory);
+		return EXIT_FAILURE;
+	}
+	output_directory = g_build_filename(corpus_directory, "out", NULL);
+
+	corpus_bytes = generate_corpus(corpus_directory);
+	g_print("corpus: %d files, %.2f MB, depth %d, "
+		"%d objects and %d signals per file\n",
+		file_count, corpus_bytes / (1024.0 * 1024.0), depth, objects,
+		signals);
+
+	for (gint i = 0; i < iterations && !compare_engines; i++) {
+		BenchRun run = run_generator(corpus_directory, output_directory,
+					     NULL);
+		if (!run.success) {
+			success = FALSE;
+			break;
+		}
+		g_array_append_val(runs, run);
+	}
+
+	if (compare_engines)
+		success = compare_engines_on_corpus(
+			corpus_directory, output_directory, corpus_bytes);
+	else if (success)
+		print_report(runs, corpus_bytes);
+
+	if (!keep) {
+		remove_directory(output_directory);
+		if (temporary_corpus)
+			remove_directory(corpus_directory);
+	} else {
+		g_print("corpus kept in %s\n", corpus_directory);
+	}
+
+	// Clean up
+	if (generator)
+		g_free(generator);
+	if (corpus_directory)
+		g_free(corpus_directory);
+	if (generator_args)
+		g_strfreev(generator_args);
+	return success ? 0 : EXIT_FAILURE;
+}
+
+static void parse_arguments(int argc, char *argv[])
+{
+	g_autoptr(GOptionContext)
+		context = g_option_context_new("- View Binding Benchmark");
+	g_autoptr(GError) error = NULL;
+
+	g_option_context_add_main_entries(context, entries, NULL);
+	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+		g_printerr("Error parsing options: %s\n", error->message);
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void check_arguments(const gchar *program_name)
+{
+	if (generator == NULL) {
+		// xmake puts both targets into the same build directory
+		g_autofree gchar *program_dir =
+			g_path_get_dirname(program_name);
+		generator = g_build_filename(program_dir, "viewbinding", NULL);
+	}
+	if (!g_file_test(generator, G_FILE_TEST_IS_EXECUTABLE)) {
+		g_printerr("Error: --generator '%s' is not an executable.\n",
+			   generator);
+		exit(EXIT_FAILURE);
+	}
+
+	if (file_count <= 0 || depth <= 0 || objects <= 0 || signals < 0 ||
+	    iterations <= 0) {
+		g_printerr(
+			"Error: --files, --depth, --objects and --iterations must be positive, --signals must not be negative.\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+/*
+ * Writes file_count UI files and returns their total size. The same seed
+ * always gives the same corpus, so numbers of different builds compare.
+ */
+static guint64 generate_corpus(const gchar *corpus_directory)
+{
+	g_autoptr(GRand) rand = g_rand_new_with_seed((guint32)seed);
+	g_autoptr(GString) output_buffer = g_string_new(NULL);
+	g_autoptr(GError) error = NULL;
+	guint64 corpus_bytes = 0;
+
+	for (gint i = 0; i < file_count; i++) {
+		g_autofree gchar *file_name =
+			g_strdup_printf("bench-%05d.ui", i);
+		g_autofree gchar *file_path =
+			g_build_filename(corpus_directory, file_name, NULL);
+
+		g_string_truncate(output_buffer, 0);
+		corpus_bytes += generate_ui_file(output_buffer, rand, i);
+		if (!g_file_set_contents(file_path, output_buffer->str,
+					 output_buffer->len, &error)) {
+			g_printerr("Error writing to file %s: %s\n", file_path,
+				   error->message);
+			exit(EXIT_FAILURE);
+		}
+	}
+	return corpus_bytes;
+}
+
+static gsize generate_ui_file(GString *output_buffer, GRand *rand,
+			      guint file_index)
+{
+	guint objects_left = objects;
+	guint signals_left = signals;
+
+	g_string_append(output_buffer,
+			"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+	g_string_append(output_buffer, "<interface>\n");
+	g_string_append_printf(
+		output_buffer,
+		"  <template class=\"BenchWindow%u\" parent=\"GtkApplicationWindow\">\n",
+		file_index);
+	g_string_append(
+		output_buffer,
+		"    <property name=\"title\" translatable=\"yes\">Bench &amp; Window</property>\n");
+	while (objects_left > 0)
+		generate_object(output_buffer, rand, file_index, 1,
+				&objects_left, &signals_left);
+	g_string_append(output_buffer, "  </template>\n");
+	g_string_append(output_buffer, "</interface>\n");
+	return output_buffer->len;
+}
+
+/*
+ * Spends objects and signals depth first, each object gets up to three
+ * children until depth is reached. Signals are spread evenly over the
+ * objects and reuse a few handler names, like real templates do.
+ */
+static void generate_object(GString *output_buffer, GRand *rand,
+			    guint file_index, guint level, guint *objects_left,
+			    guint *signals_left)
+{
+	const guint object_index = objects - *objects_left;
+	const guint signals_wanted =
+		(guint)((guint64)(object_index + 1) * signals / objects);
+	const gchar *class_name = widget_classes[g_rand_int_range(
+		rand, 0, G_N_ELEMENTS(widget_classes))];
+	g_autofree gchar *indent = g_strnfill(level * 4, ' ');
+
+	(*objects_left)--;
+	g_string_append_printf(output_buffer, "%s<child>\n", indent);
+	// the syntax the fast scanner has to decode the way GMarkup does
+	switch (object_index % 6) {
+	case 1:
+		g_string_append_printf(
+			output_buffer,
+			"%s  <object class='%s' id='widget-%u'>\n", indent,
+			class_name, object_index);
+		break;
+	case 2:
+		g_string_append_printf(
+			output_buffer,
+			"%s  <object class=\"%s\" id=\"widget&#45;%u\">\n",
+			indent, class_name, object_index);
+		break;
+	case 3:
+		g_string_append_printf(
+			output_buffer,
+			"%s  <object\n%s\tclass=\"%s\"\r\n%s\tid = \"widget-%u\" >\n",
+			indent, indent, class_name, indent, object_index);
+		break;
+	default:
+		g_string_append_printf(
+			output_buffer,
+			"%s  <object class=\"%s\" id=\"widget-%u\">\n", indent,
+			class_name, object_index);
+		break;
+	}
+	g_string_append_printf(
+		output_buffer,
+		"%s    <property name=\"margin-start\">%u</property>\n", indent,
+		g_rand_int_range(rand, 0, 24));
+	if (object_index % 6 == 4) {
+		g_string_append_printf(
+			output_buffer,
+			"%s    <!-- <object class=\"GtkLabel\" id=\"comment-%u\"> -->\n",
+			indent, object_index);
+		g_string_append_printf(
+			output_buffer,
+			"%s    <property name=\"tooltip-markup\"><![CDATA[<object class=\"GtkLabel\" id=\"cdata-%u\"/> &amp; <b>bold</b>]]></property>\n",
+			indent, object_index);
+		g_string_append_printf(
+			output_buffer,
+			"%s    <child><object class=\"GtkSeparator\" id=\"separator-%u\"/></child>\n",
+			indent, object_index);
+	}
+	while (*signals_left > 0 && signals - *signals_left < signals_wanted) {
+		// every fifth handler ends in whitespace the parsers normalize
+		const gboolean normalized = *signals_left % 5 == 0;
+
+		(*signals_left)--;
+		g_string_append_printf(
+			output_buffer,
+			"%s    <signal name=\"notify\" handler=\"bench_%u_on_changed_%u%s\" swapped=\"no\"/>\n",
+			indent, file_index, g_rand_int_range(rand, 0, 4),
+			normalized ? "\t\n\r\n\r" : "");
+	}
+
+	if (level < (guint)depth) {
+		guint children = g_rand_int_range(rand, 0, 4);
+		for (guint i = 0; i < children && *objects_left > 0; i++)
+			generate_object(output_buffer, rand, file_index,
+					level + 1, objects_left, signals_left);
+	}
+
+	g_string_append_printf(output_buffer, "%s  </object>\n", indent);
+	g_string_append_printf(output_buffer, "%s</child>\n", indent);
+}
+
+static BenchRun run_generator(const gchar *corpus_directory,
+			      const gchar *output_directory,
+			      const gchar *const *config_args)
+{
+	g_autoptr(GPtrArray) args = g_ptr_array_new();
+	g_autoptr(GError) error = NULL;
+	g_autofree gchar *standard_error = NULL;
+	BenchRun run = { 0 };
+	gint wait_status = 0;
+	gint64 start_time = 0;
+
+	/*
+	 * --no-cache and --always-write so that every run goes through the
+	 * whole pipeline, writes included
+	 */
+	g_ptr_array_add(args, generator);
+	g_ptr_array_add(args, "-a");
+	g_ptr_array_add(args, "org_viewbinding_Bench");
+	g_ptr_array_add(args, "-d");
+	g_ptr_array_add(args, (gpointer)corpus_directory);
+	g_ptr_array_add(args, "-o");
+	g_ptr_array_add(args, (gpointer)output_directory);
+	g_ptr_array_add(args, "--no-cache");
+	g_ptr_array_add(args, "--always-write");
+	for (const gchar *const *arg = config_args; arg && *arg; arg++)
+		g_ptr_array_add(args, (gpointer)*arg);
+	// after the configuration, so that they can override it
+	for (gchar **arg = generator_args; arg && *arg; arg++) {
+		if (g_strcmp0(*arg, "--") != 0)
+			g_ptr_array_add(args, *arg);
+	}
+	g_ptr_array_add(args, NULL);
+
+	start_time = g_get_monotonic_time();
+	if (!g_spawn_sync(NULL, (gchar **)args->pdata, NULL,
+			  G_SPAWN_STDOUT_TO_DEV_NULL, NULL, NULL, NULL,
+			  &standard_error, &wait_status, &error)) {
+		g_printerr("Error running %s: %s\n", generator, error->message);
+		return run;
+	}
+	run.elapsed_usec = g_get_monotonic_time() - start_time;
+
+	if (!g_spawn_check_wait_status(wait_status, &error)) {
+		g_printerr("Error running %s: %s\n%s", generator,
+			   error->message, standard_error);
+		return run;
+	}
+	run.success = TRUE;
+	return run;
+}
+
+/*
+ * Runs every configuration into its own directory below output_directory.
+ * Fails when a run fails or a configuration generates other files than the
+ * baseline.
+ */
+static gboolean compare_engines_on_corpus(const gchar *corpus_directory,
+					  const gchar *output_directory,
+					  guint64 corpus_bytes)
+{
+	g_autofree gchar *baseline_directory = g_build_filename(
+		output_directory, engine_configs[0].name, NULL);
+	const gdouble megabytes = corpus_bytes / (1024.0 * 1024.0);
+	gdouble baseline_median = 0;
+	gboolean success = TRUE;
+
+	g_print("%-14s %10s %10s %12s %10s %8s  %s\n", "", "best", "median",
+		"files/sec", "MB/sec", "speedup", "output");
+	for (guint i = 0; i < G_N_ELEMENTS(engine_configs); i++) {
+		const EngineConfig *config = &engine_configs[i];
+		g_autofree gchar *config_directory =
+			g_build_filename(output_directory, config->name, NULL);
+		g_autoptr(GArray) runs =
+			g_array_new(FALSE, FALSE, sizeof(BenchRun));
+		g_autofree gchar *output = NULL;
+		gdouble best = 0;
+		gdouble median = 0;
+		guint differences = 0;
+
+		for (gint j = 0; j < iterations; j++) {
+			BenchRun run = run_generator(corpus_directory,
+						     config_directory,
+						     config->args);
+			if (!run.success)
+				return FALSE;
+			g_array_append_val(runs, run);
+		}
+
+		g_array_sort(runs, compare_runs);
+		best = g_array_index(runs, BenchRun, 0).elapsed_usec / 1e6;
+		median = g_array_index(runs, BenchRun, runs->len / 2)
+				 .elapsed_usec /
+			 1e6;
+		if (i == 0) {
+			baseline_median = median;
+			output = g_strdup("baseline");
+		} else {
+			differences = compare_outputs(baseline_directory,
+						      config_directory);
+			output = differences == 0 ?
+					 g_strdup("identical") :
+					 g_strdup_printf("%u files differ",
+							 differences);
+		}
+		if (differences > 0)
+			success = FALSE;
+
+		g_print("%-14s %10.4f %10.4f %12.1f %10.2f %7.2fx  %s\n",
+			config->name, best, median, file_count / median,
+			megabytes / median, baseline_median / median, output);
+	}
+
+	// one process per file, so it is not timed
+	{
+		const guint differences = compare_standard_input(
+			corpus_directory, baseline_directory);
+		g_autofree gchar *output =
+			differences == 0 ?
+				g_strdup("identical") :
+				g_strdup_printf("%u files differ", differences);
+
+		g_print("%-14s %10s %10s %12s %10s %8s  %s\n", "stdin-stream",
+			"-", "-", "-", "-", "-", output);
+		if (differences > 0)
+			success = FALSE;
+	}
+
+	{
+		const guint unknown = check_type_functions(corpus_directory,
+							   baseline_directory);
+		g_autofree gchar *output =
+			unknown == 0 ?
+				g_strdup("as GtkBuilder") :
+				g_strdup_printf("%u unknown", unknown);
+
+		g_print("%-14s %10s %10s %12s %10s %8s  %s\n", "type-names",
+			"-", "-", "-", "-", "-", output);
+		if (unknown > 0)
+			success = FALSE;
+	}
+
+	{
+		const guint wrong = check_exclusions(corpus_directory);
+		g_autofree gchar *output =
+			wrong == 0 ? g_strdup("as documented") :
+				     g_strdup_printf("%u wrong", wrong);
+
+		g_print("%-14s %10s %10s %12s %10s %8s  %s\n", "exclusions",
+			"-", "-", "-", "-", "-", output);
+		if (wrong > 0)
+			success = FALSE;
+	}
+	return success;
+}
+
+/*
+ * Generates two files in every configuration: one whose GtkSpinner is
+ * excluded by an annotation, which still has to register the class no
+ * other object uses, and one left without any object by --bind-exclude,
+ * which has to lose its binding struct and keep its types. Counts the
+ * headers that do not.
+ */
+static guint check_exclusions(const gchar *corpus_directory)
+{
+	static const gchar annotated[] =
+		"<interface>\n"
+		"  <!-- viewbinding:exclude GtkSpinner -->\n"
+		"  <object class=\"GtkWindow\" id=\"window\">\n"
+		"    <child><object class=\"GtkSpinner\" id=\"spinner\"/>"
+		"</child>\n"
+		"  </object>\n"
+		"</interface>\n";
+	static const gchar unbound[] =
+		"<interface>\n"
+		"  <object class=\"GtkWindow\" id=\"window\">\n"
+		"    <child><object class=\"GtkLabel\" id=\"label\"/>"
+		"</child>\n"
+		"  </object>\n"
+		"</interface>\n";
+	guint wrong = 0;
+
+	for (guint i = 0; i < G_N_ELEMENTS(engine_configs); i++) {
+		const EngineConfig *config = &engine_configs[i];
+		g_autoptr(GPtrArray) args = g_ptr_array_new();
+		g_autofree gchar *annotated_header = NULL;
+		g_autofree gchar *unbound_header = NULL;
+
+		for (const gchar *const *arg = config->args; *arg; arg++)
+			g_ptr_array_add(args, (gpointer)*arg);
+		g_ptr_array_add(args, "--bind-exclude");
+		g_ptr_array_add(args, "*");
+		g_ptr_array_add(args, NULL);
+		annotated_header = generate_fixture(corpus_directory,
+						    "annotated", annotated,
+						    config->args);
+		unbound_header = generate_fixture(
+			corpus_directory, "unbound", unbound,
+			(const gchar *const *)args->pdata);
+
+		if (annotated_header == NULL ||
+		    strstr(annotated_header, "GtkSpinner *") != NULL ||
+		    strstr(annotated_header,
+			   "g_type_ensure(gtk_spinner_get_type())") == NULL) {
+			g_printerr("%s: the excluded GtkSpinner is bound or "
+				   "not registered\n",
+				   config->name);
+			wrong++;
+		}
+		if (unbound_header == NULL ||
+		    strstr(unbound_header, "UnboundBinding") != NULL ||
+		    strstr(unbound_header,
+			   "g_type_ensure(gtk_label_get_type())") == NULL) {
+			g_printerr("%s: the file without bound objects has a "
+				   "binding struct or no types\n",
+				   config->name);
+			wrong++;
+		}
+	}
+	return wrong;
+}
+
+/*
+ * Counts the g_type_ensure() calls of the baseline headers whose function
+ * is not the one GtkBuilder looks up for one of the widget classes, and the
+ * digit_type_names the generator or the copy of GtkBuilder's mangling get
+ * wrong
+ */
+static guint check_type_functions(const gchar *corpus_directory,
+				  const gchar *baseline_directory)
+{
+	g_autoptr(GHashTable) function_names =
+		g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	g_autoptr(GDir) dir = g_dir_open(baseline_directory, 0, NULL);
+	g_autoptr(GString) fixture = g_string_new("<interface>\n");
+	g_autofree gchar *header = NULL;
+	const gchar *name = NULL;
+	guint unknown = 0;
+
+	for (guint i = 0; i < G_N_ELEMENTS(digit_type_names); i++)
+		g_string_append_printf(
+			fixture, "  <object class=\"%s\" id=\"object%u\"/>\n",
+			digit_type_names[i].class_name, i);
+	g_string_append(fixture, "</interface>\n");
+	header = generate_fixture(corpus_directory, "type_names",
+				  fixture->str, NULL);
+	for (guint i = 0; i < G_N_ELEMENTS(digit_type_names); i++) {
+		const gchar *function_name = digit_type_names[i].function_name;
+		g_autofree gchar *mangled =
+			mangle_type_name(digit_type_names[i].class_name);
+		g_autofree gchar *call =
+			g_strdup_printf("g_type_ensure(%s())", function_name);
+
+		if (strcmp(mangled, function_name) != 0 || header == NULL ||
+		    strstr(header, call) == NULL) {
+			g_printerr("%s is not registered with %s()\n",
+				   digit_type_names[i].class_name,
+				   function_name);
+			unknown++;
+		}
+	}
+
+	for (guint i = 0; i < G_N_ELEMENTS(widget_classes); i++)
+		g_hash_table_add(function_names,
+				 mangle_type_name(widget_classes[i]));
+	// the self-closing children
+	g_hash_table_add(function_names, mangle_type_name("GtkSeparator"));
+
+	if (dir == NULL)
+		return 1;
+	while ((name = g_dir_read_name(dir)) != NULL) {
+		g_autofree gchar *path =
+			g_build_filename(baseline_directory, name, NULL);
+		g_autofree gchar *content = NULL;
+		const gchar *p = NULL;
+
+		if (name[0] == '.' ||
+		    !g_file_get_contents(path, &content, NULL, NULL))
+			continue;
+		p = content;
+		while ((p = strstr(p, "g_type_ensure(")) != NULL) {
+			const gchar *start = p + strlen("g_type_ensure(");
+			const gchar *end = strstr(start, "()");
+			g_autofree gchar *function_name =
+				end ? g_strndup(start, end - start) : NULL;
+
+			if (function_name == NULL ||
+			    !g_hash_table_contains(function_names,
+						   function_name)) {
+				if (unknown == 0)
+					g_printerr(
+						"%s calls %s(), which GtkBuilder "
+						"does not look up\n",
+						path,
+						function_name ? function_name :
+								"?");
+				unknown++;
+			}
+			p = start;
+		}
+	}
+	return unknown;
+}
+
+/*
+ * type_name_mangle() of GtkBuilder, splitting the first capital, copied so
+ * that the generator is checked against it rather than against itself
+ */
+static gchar *mangle_type_name(const gchar *name)
+{
+	GString *symbol_name = g_string_new(NULL);
+
+	for (gint i = 0; name[i] != '\0'; i++) {
+		if ((name[i] == g_ascii_toupper(name[i]) &&
+		     ((i > 0 && name[i - 1] != g_ascii_toupper(name[i - 1])) ||
+		      (i == 1 && name[0] == g_ascii_toupper(name[0])))) ||
+		    (i > 2 && name[i] == g_ascii_toupper(name[i]) &&
+		     name[i - 1] == g_ascii_toupper(name[i - 1]) &&
+		     name[i - 2] == g_ascii_toupper(name[i - 2])))
+			g_string_append_c(symbol_name, '_');
+		g_string_append_c(symbol_name, g_ascii_tolower(name[i]));
+	}
+	g_string_append(symbol_name, "_get_type");
+	return g_string_free(symbol_name, FALSE);
+}
+
+/*
+ * Writes content to <name>.ui in a directory of its own below
+ * corpus_directory and runs the generator on it. Returns the header it
+ * generated, NULL when there is none.
+ */
+static gchar *generate_fixture(const gchar *corpus_directory,
+			       const gchar *name, const gchar *content,
+			       const gchar *const *config_args)
+{
+	g_autofree gchar *fixture_name = g_strconcat("fixture-", name, NULL);
+	g_autofree gchar *fixture_directory =
+		g_build_filename(corpus_directory, fixture_name, NULL);
+	g_autofree gchar *output_directory =
+		g_build_filename(fixture_directory, "out", NULL);
+	g_autofree gchar *file_name = g_strconcat(name, ".ui", NULL);
+	g_autofree gchar *file_path =
+		g_build_filename(fixture_directory, file_name, NULL);
+	g_autofree gchar *header_name =
+		g_strconcat(name, "_viewbinding.h", NULL);
+	g_autofree gchar *header_path =
+		g_build_filename(output_directory, header_name, NULL);
+	gchar *header = NULL;
+
+	if (g_mkdir_with_parents(fixture_directory, 0755) == 0 &&
+	    g_file_set_contents(file_path, content, -1, NULL) &&
+	    run_generator(fixture_directory, output_directory, config_args)
+		    .success)
+		g_file_get_contents(header_path, &header, NULL, NULL);
+	remove_directory(fixture_directory);
+	return header;
+}
+
+/*
+ * Pipes every corpus file through "--read-mode stream -", which has to
+ * read standard input instead of a file of that name, and compares what it
+ * writes to standard output with the baseline header
+ */
+static guint compare_standard_input(const gchar *corpus_directory,
+				    const gchar *baseline_directory)
+{
+	g_autoptr(GString) output_buffer = g_string_new(NULL);
+	guint differences = 0;
+
+	for (gint i = 0; i < file_count; i++) {
+		g_autofree gchar *file_name =
+			g_strdup_printf("bench-%05d.ui", i);
+		g_autofree gchar *header_name =
+			g_strdup_printf("bench_%05d_viewbinding.h", i);
+		g_autofree gchar *file_path =
+			g_build_filename(corpus_directory, file_name, NULL);
+		g_autofree gchar *baseline_path = g_build_filename(
+			baseline_directory, header_name, NULL);
+		g_autofree gchar *baseline_content = NULL;
+		gsize baseline_size = 0;
+
+		g_string_truncate(output_buffer, 0);
+		if (!run_generator_on_stdin(file_path, file_name,
+					    output_buffer) ||
+		    !g_file_get_contents(baseline_path, &baseline_content,
+					 &baseline_size, NULL) ||
+		    baseline_size != output_buffer->len ||
+		    memcmp(baseline_content, output_buffer->str,
+			   baseline_size) != 0) {
+			if (differences == 0)
+				g_printerr("%s from standard input "
+					   "differs from %s\n",
+					   file_name, baseline_path);
+			differences++;
+		}
+	}
+	return differences;
+}
+
+/*
+ * The generator reads all of standard input before it writes the header, so
+ * the input can be written in full before the output is read
+ */
+static gboolean run_generator_on_stdin(const gchar *file_path,
+				       const gchar *file_name,
+				       GString *output_buffer)
+{
+	g_autoptr(GPtrArray) args = g_ptr_array_new();
+	g_autoptr(GError) error = NULL;
+	g_autofree gchar *content = NULL;
+	gsize size = 0;
+	GPid pid = 0;
+	gint stdin_fd = -1;
+	gint stdout_fd = -1;
+	gint wait_status = 0;
+	gchar buffer[64 * 1024];
+	gssize read_size = 0;
+	gboolean written = FALSE;
+
+	if (!g_file_get_contents(file_path, &content, &size, &error)) {
+		g_printerr("Error reading file %s: %s\n", file_path,
+			   error->message);
+		return FALSE;
+	}
+
+	g_ptr_array_add(args, generator);
+	g_ptr_array_add(args, "-a");
+	g_ptr_array_add(args, "org_viewbinding_Bench");
+	g_ptr_array_add(args, "--read-mode");
+	g_ptr_array_add(args, "stream");
+	g_ptr_array_add(args, "--stdin-name");
+	g_ptr_array_add(args, (gpointer)file_name);
+	for (gchar **arg = generator_args; arg && *arg; arg++) {
+		if (g_strcmp0(*arg, "--") != 0)
+			g_ptr_array_add(args, *arg);
+	}
+	g_ptr_array_add(args, "-");
+	g_ptr_array_add(args, NULL);
+
+	if (!g_spawn_async_with_pipes(NULL, (gchar **)args->pdata, NULL,
+				      G_SPAWN_DO_NOT_REAP_CHILD |
+					      G_SPAWN_STDERR_TO_DEV_NULL,
+				      NULL, NULL, &pid, &stdin_fd, &stdout_fd,
+				      NULL, &error)) {
+		g_printerr("Error running %s: %s\n", generator, error->message);
+		return FALSE;
+	}
+
+	written = write_all(stdin_fd, content, size);
+	close(stdin_fd);
+	while ((read_size = read(stdout_fd, buffer, sizeof(buffer))) > 0)
+		g_string_append_len(output_buffer, buffer, read_size);
+	close(stdout_fd);
+	waitpid(pid, &wait_status, 0);
+	g_spawn_close_pid(pid);
+
+	return written && read_size == 0 &&
+	       g_spawn_check_wait_status(wait_status, NULL);
+}
+
+static gboolean write_all(gint fd, const gchar *data, gsize size)
+{
+	while (size > 0) {
+		const gssize written = write(fd, data, size);
+		if (written < 0)
+			return FALSE;
+		data += written;
+		size -= written;
+	}
+	return TRUE;
+}
+
+/*
+ * Counts the generated files that are missing on either side or differ
+ * byte for byte. Dot files, such as the manifest, are left out.
+ */
+static guint compare_outputs(const gchar *baseline_directory,
+			     const gchar *output_directory)
+{
+	g_autoptr(GDir) dir = g_dir_open(baseline_directory, 0, NULL);
+	const gchar *name = NULL;
+	guint differences = 0;
+
+	if (dir == NULL)
+		return 1;
+	while ((name = g_dir_read_name(dir)) != NULL) {
+		g_autofree gchar *baseline_path =
+			g_build_filename(baseline_directory, name, NULL);
+		g_autofree gchar *output_path =
+			g_build_filename(output_directory, name, NULL);
+		g_autofree gchar *baseline_content = NULL;
+		g_autofree gchar *output_content = NULL;
+		gsize baseline_size = 0;
+		gsize output_size = 0;
+
+		if (name[0] == '.')
+			continue;
+		if (!g_file_get_contents(baseline_path, &baseline_content,
+					 &baseline_size, NULL) ||
+		    !g_file_get_contents(output_path, &output_content,
+					 &output_size, NULL) ||
+		    baseline_size != output_size ||
+		    memcmp(baseline_content, output_content, baseline_size) !=
+			    0) {
+			if (differences == 0)
+				g_printerr("%s differs from %s\n", output_path,
+					   baseline_path);
+			differences++;
+		}
+	}
+	return differences +
+	       count_missing_files(output_directory, baseline_directory);
+}
+
+// The files of directory that other_directory lacks, dot files left out
+static guint count_missing_files(const gchar *directory,
+				 const gchar *other_directory)
+{
+	g_autoptr(GDir) dir = g_dir_open(directory, 0, NULL);
+	const gchar *name = NULL;
+	guint missing = 0;
+
+	if (dir == NULL)
+		return 0;
+	while ((name = g_dir_read_name(dir)) != NULL) {
+		g_autofree gchar *other_path =
+			g_build_filename(other_directory, name, NULL);
+
+		if (name[0] != '.' &&
+		    !g_file_test(other_path, G_FILE_TEST_EXISTS))
+			missing++;
+	}
+	return missing;
+}
+
+static gint compare_runs(gconstpointer a, gconstpointer b)
+{
+	const BenchRun *run_a = (const BenchRun *)a;
+	const BenchRun *run_b = (const BenchRun *)b;
+	return (run_a->elapsed_usec > run_b->elapsed_usec) -
+	       (run_a->elapsed_usec < run_b->elapsed_usec);
+}
+
+static void print_report(GArray *runs, guint64 corpus_bytes)
+{
+	struct rusage usage = { 0 };
+	const gdouble megabytes = corpus_bytes / (1024.0 * 1024.0);
+	gdouble best = 0;
+	gdouble median = 0;
+
+	g_array_sort(runs, compare_runs);
+	best = g_array_index(runs, BenchRun, 0).elapsed_usec / 1e6;
+	median =
+		g_array_index(runs, BenchRun, runs->len / 2).elapsed_usec / 1e6;
+
+	// the largest resident set of all waited for children
+	getrusage(RUSAGE_CHILDREN, &usage);
+
+	g_print("%-8s %10s %12s %10s\n", "", "seconds", "files/sec", "MB/sec");
+	g_print("%-8s %10.4f %12.1f %10.2f\n", "best", best, file_count / best,
+		megabytes / best);
+	g_print("%-8s %10.4f %12.1f %10.2f\n", "median", median,
+		file_count / median, megabytes / median);
+	g_print("peak rss: %ld KiB\n", usage.ru_maxrss);
+}
+
+static void remove_directory(const gchar *path)
+{
+	g_autoptr(GDir) dir = g_dir_open(path, 0, NULL);
+	const gchar *name = NULL;
+
+	if (dir == NULL)
+		return;
+	while ((name = g_dir_read_name(dir)) != NULL) {
+		g_autofree gchar *child = g_build_filename(path, name, NULL);
+		if (g_file_test(child, G_FILE_TEST_IS_DIR) &&
+		    !g_file_test(child, G_FILE_TEST_IS_SYMLINK))
+			remove_directory(child);
+		else
+			g_unlink(child);
+	}
+	g_rmdir(path);
+}
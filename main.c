@@ -18,73 +18,665 @@
   * along with this program.  If not, see <https://www.gnu.org/licenses/>.
   **/
 
+#include <errno.h>
+#include <string.h>
+
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <gio/gio.h>
+#ifdef G_OS_UNIX
+#include <glib-unix.h>
+#include <signal.h>
+#include <sys/stat.h>
+#endif
+
+/*
+ * --alloc-stats replaces the malloc of glibc, only in builds configured with
+ * the alloc-stats option. Sanitizers replace it already.
+ */
+#if defined(VIEW_BINDING_ALLOC_STATS) && defined(__GLIBC__) && \
+	!defined(__SANITIZE_ADDRESS__) && !defined(__SANITIZE_THREAD__)
+#define HAVE_ALLOC_STATS
+#include <malloc.h>
+#include <sys/resource.h>
+#endif
+
+#define VIEW_BINDING_VERSION "1.1.0"
+
+// Name of the incremental generation cache kept in the output directory
+#define CACHE_MANIFEST_NAME ".viewbinding-manifest"
+#define CACHE_SETTINGS_GROUP "viewbinding"
 
+// Helpers shared by every header when --common-header is given
+#define COMMON_HEADER_NAME "viewbinding_common.h"
+
+// Upper bound for one string of a --server request or reply
+#define MESSAGE_MAX_LENGTH (64 * 1024 * 1024)
+
+/*
+ * Ids point into the arena of ViewBindingState, cleared per file. Class and
+ * handler names repeat across files and are interned for the whole run, so
+ * equal names are equal pointers.
+ */
 typedef struct {
-	gchar *class;
-	gchar *id;
+	const gchar *class;
+	const gchar *id;
+	const gchar *field; // id with hyphens replaced, a C identifier
+	// field of the outermost object it is part of, NULL when that has no id
+	const gchar *group;
 } ClassId;
 
+typedef struct {
+	GArray *class_ids; // objects with an id, in document order
+	GPtrArray *type_names; // every object class, without duplicates
+	guint depth; // open <object> elements
+	const gchar *group; // of the open outermost object
+} ObjectBindings;
+
+typedef struct {
+	const gchar *handler;
+	const gchar *symbol; // handler with hyphens replaced
+} SignalHandler;
+
+typedef struct {
+	GString *output_buffer;
+	GString *source_buffer; // NULL unless --emit-source is given
+	const gchar *base_name;
+} ViewBindingOutput;
+
 typedef struct {
 	gchar *element_name;
 
-	void (*handle_attribute)(const gchar *element_name,
+	void (*handle_attribute)(GStringChunk *arena, const gchar *element_name,
 				 const gchar **attribute_name,
 				 const gchar **attribute_value,
 				 gpointer user_data);
 
-	void (*generate_code)(const gchar *base_name, gpointer user_data);
+	// NULL for parsers that do not care where elements end
+	void (*handle_end)(const gchar *element_name, gpointer user_data);
+
+	void (*generate_code)(ViewBindingOutput *output, gpointer user_data);
 
 	GDestroyNotify destroy_user_data;
 	gpointer user_data;
+	guint element_count; // elements seen in the current file
 } ViewBindingParser;
 
-static void parse_arguments(int argc, char *argv[]);
+// Parsers in the order their code is generated
+typedef enum {
+	PARSER_OBJECT,
+	PARSER_SIGNAL,
+	N_PARSERS,
+} ParserKind;
+
+/*
+ * Per-thread parsing state, created by the first file a thread parses and
+ * reset in place for every later one
+ */
+typedef struct {
+	ViewBindingParser parsers[N_PARSERS];
+	GStringChunk *arena;
+	const gchar *file_name; // the file being parsed
+	// GPatternSpec, from viewbinding: comments of the file
+	GPtrArray *include_specs;
+	GPtrArray *exclude_specs;
+	// --minify-ui: the copy being built, whitespace that may be dropped
+	// and whether the last start tag still lacks its '>'
+	GString *minified_buffer;
+	GString *pending_space;
+	gboolean tag_open;
+	// field name -> id of the objects bound so far
+	GHashTable *fields;
+} ViewBindingState;
+
+
+typedef enum {
+	READ_MODE_READ,
+	READ_MODE_MMAP,
+	READ_MODE_STREAM,
+} ReadMode;
+
+typedef enum {
+	PARSE_ENGINE_MARKUP,
+	PARSE_ENGINE_FAST,
+} ParseEngine;
+
+typedef enum {
+	BINDING_STYLE_MACRO,
+	BINDING_STYLE_TABLE,
+} BindingStyle;
+
+typedef enum {
+	STRUCT_LAYOUT_FLAT,
+	STRUCT_LAYOUT_NESTED,
+} StructLayout;
+
+typedef enum {
+	OUTPUT_MODE_REPLACE,
+	OUTPUT_MODE_STREAM,
+} OutputMode;
+
+/*
+ * One generated file. In replace mode the whole buffer is written on close,
+ * in stream mode every flush hands the buffer to the output file, which is
+ * only opened once the code differs from what the file already holds.
+ */
+typedef struct {
+	const gchar *file_path;
+	GString *buffer; // code not yet handed to the file
+	gsize offset; // bytes flushed so far
+	GMappedFile *existing; // previous content, NULL once opened
+	GFileIOStream *file_stream;
+	GOutputStream *stream; // NULL while the code matches the file
+	gint64 write_usec;
+} OutputWriter;
+
+// Phase times of one file, only recorded with --stats or --stats-json
+typedef struct {
+	gchar *file_name;
+	gint64 total_usec;
+	gint64 read_usec;
+	gint64 parse_usec; // includes reading in stream mode
+	gint64 generate_usec;
+	gint64 write_usec;
+	guint objects;
+	guint signals;
+	guint64 bytes_in;
+	guint64 bytes_out;
+	gboolean unchanged; // skipped by the cache
+} FileStats;
+
+typedef struct {
+	GArray *files; // FileStats
+	gint64 wall_usec;
+	gint64 scan_usec;
+	gint64 cache_usec;
+	gint64 depfile_usec;
+} RunStats;
+
+// What an allocation is made for, only counted with --alloc-stats
+typedef enum {
+	ALLOC_PHASE_OTHER, // scanning, the cache, the threads between files
+	ALLOC_PHASE_READ,
+	ALLOC_PHASE_PARSE, // the parse engine, includes reading in stream mode
+	ALLOC_PHASE_ATTRIBUTES, // the handle_attribute() of the parsers
+	ALLOC_PHASE_GENERATE, // includes writing
+	N_ALLOC_PHASES,
+} AllocPhase;
+
+typedef struct {
+	gsize count;
+	gsize bytes;
+} AllocCounter;
+
+typedef struct {
+	GPtrArray *file_names; // relative to --directory
+	GPtrArray *dir_names; // subdirectories, relative to --directory
+	GThreadPool *file_pool; // NULL in serial mode
+	GThreadPool *dir_pool; // NULL unless recursive and parallel
+	GMutex lock;
+	GCond dirs_done;
+	guint pending_dirs;
+} ScanState;
+
+typedef struct {
+	GMainLoop *loop;
+	GFile *root;
+	GPtrArray *file_names;
+	GPtrArray *dir_names;
+	GPtrArray *monitors;
+	GHashTable *pending_files; // file name -> debounce timeout id
+	gboolean file_set_changed;
+} WatchState;
+
+typedef struct {
+	WatchState *state;
+	gchar *file_name;
+} PendingFile;
+
+// A manifest the server wrote, reused while the file is left as written
+typedef struct {
+	GKeyFile *key_file;
+	guint64 size;
+	guint64 mtime;
+	guint64 inode;
+} WarmManifest;
+
+static void parse_arguments(gchar **arguments);
+
+static void reset_options(void);
+
+static int run_generator(void);
+
+static gboolean generate_all(void);
+
+static int run_server(void);
+
+static gboolean on_server_request(GSocketService *service,
+				  GSocketConnection *connection,
+				  GObject *source_object, gpointer user_data);
+
+static int serve_request(gchar **arguments);
+
+static void capture_print(const gchar *string);
+
+static void capture_printerr(const gchar *string);
+
+static gboolean run_client(gchar **arguments, int *status);
+
+static gboolean write_message_string(GDataOutputStream *stream,
+				     const gchar *data, gsize length,
+				     GError **error);
+
+static gchar *read_message_string(GDataInputStream *stream, gsize *length,
+				  GError **error);
+
+static void free_warm_manifest(WarmManifest *warm_manifest);
+
+static gboolean check_arguments(void);
+
+static gboolean expand_input_paths(void);
+
+static gboolean add_input_file(GFile *root, GHashTable *seen,
+			       const gchar *file_path);
+
+static void process_files(GPtrArray *file_names, GPtrArray *dir_names);
+
+static void process_file_worker(gpointer data, gpointer user_data);
+
+static void scan_directory(ScanState *state, const gchar *dir_name);
+
+static gint64 queue_file(ScanState *state, gchar *file_name);
+
+static gboolean is_ui_file_name(const gchar *file_name);
+
+static void scan_directory_worker(gpointer data, gpointer user_data);
+
+static gint compare_file_names(gconstpointer a, gconstpointer b);
+
+static void watch_directory(GPtrArray *file_names, GPtrArray *dir_names);
+
+static gboolean monitor_directory(WatchState *state, GFile *dir);
+
+static void watch_new_directory(WatchState *state, const gchar *dir_name);
 
-static void check_arguments(void);
+static void on_directory_changed(GFileMonitor *monitor, GFile *file,
+				 GFile *other_file, GFileMonitorEvent event,
+				 gpointer user_data);
+
+static void schedule_regeneration(WatchState *state, const gchar *file_name);
+
+static gboolean regenerate_pending_file(gpointer user_data);
+
+static void destroy_pending_file(PendingFile *pending_file);
+
+static void forget_file(WatchState *state, const gchar *file_name);
+
+static gboolean quit_main_loop(gpointer user_data);
 
 static void read_and_parse_xml_file(const gchar *file_name);
 
+static void parse_xml_file(const gchar *file_name, FileStats *file_stats);
+
+static GBytes *read_input_file(const gchar *file_path, GError **error);
+
+static GBytes *read_standard_input(GError **error);
+
+static gboolean parse_input_buffer(GMarkupParseContext *context,
+				   ViewBindingState *state, const gchar *text,
+				   gsize size, GError **error);
+
+static gboolean fast_scan_parse(ViewBindingState *state, const gchar *text,
+				gsize size, GError **error);
+
+static const gchar *fast_scan_element(ViewBindingState *state,
+				      const gchar *p, const gchar *end,
+				      GString *scratch, GArray *offsets,
+				      GError **error);
+
+static const gchar *fast_scan_skip_tag(const gchar *p, const gchar *end);
+
+static const gchar *fast_scan_end_element(ViewBindingState *state,
+					  const gchar *p, const gchar *end);
+
+static const gchar *fast_scan_skip_past(const gchar *p, const gchar *end,
+					const gchar *terminator);
+
+static void append_unescaped(GString *output_buffer, const gchar *p,
+			     const gchar *end);
+
+static void append_normalized(GString *output_buffer, const gchar *p,
+			      const gchar *end);
+
+static gboolean parse_input_stream(GMarkupParseContext *context,
+				   const gchar *file_path, gsize *size,
+				   gchar **checksum, GError **error);
+
 static void start(GMarkupParseContext *context, const gchar *element_name,
 		  const gchar **attribute_names, const gchar **attribute_values,
 		  gpointer user_data, GError **error);
 
+static void end_element(GMarkupParseContext *context,
+			const gchar *element_name, gpointer user_data,
+			GError **error);
+
+static void passthrough(GMarkupParseContext *context, const gchar *text,
+			gsize text_len, gpointer user_data, GError **error);
+
+static void handle_annotation(ViewBindingState *state, const gchar *text,
+			      gsize length);
+
+static void minify_start(GMarkupParseContext *context,
+			 const gchar *element_name,
+			 const gchar **attribute_names,
+			 const gchar **attribute_values, gpointer user_data,
+			 GError **error);
+
+static void minify_end(GMarkupParseContext *context, const gchar *element_name,
+		       gpointer user_data, GError **error);
+
+static void minify_text(GMarkupParseContext *context, const gchar *text,
+			gsize text_len, gpointer user_data, GError **error);
+
+static void minify_passthrough(GMarkupParseContext *context,
+			       const gchar *text, gsize text_len,
+			       gpointer user_data, GError **error);
+
+static gboolean is_default_attribute(const gchar *element_name,
+				     const gchar *attribute_name,
+				     const gchar *attribute_value,
+				     gboolean translatable);
+
+static void close_start_tag(ViewBindingState *state);
+
+static void append_escaped(GString *output_buffer, const gchar *text,
+			   gsize length, gboolean attribute);
+
+static void filter_object_bindings(ViewBindingState *state);
+
+static gboolean check_object_ids(ViewBindingState *state);
+
+static gboolean index_file_symbols(const gchar *file_name);
+
+static gboolean index_symbol(const gchar *symbol, const gchar *file_name,
+			     const gchar *description, gboolean fatal);
+
+static void unindex_file_symbols(const gchar *file_name);
+
+static gchar **index_group_structs(ViewBindingState *state,
+				   const gchar *file_name);
+
+static void index_cached_structs(const gchar *file_name);
+
+static gboolean object_is_bound(ViewBindingState *state,
+				const ClassId *class_id);
+
+static gboolean match_any_spec(GPtrArray *specs, const ClassId *class_id);
+
 static void destroy_view_binding_parser(ViewBindingParser *parser);
 
-static void destroy_list_class_id(GList **class_id_list);
+static ViewBindingState *get_view_binding_state(void);
+
+static void reset_view_binding_state(ViewBindingState *state);
+
+static void free_view_binding_state(ViewBindingState *state);
+
+static ViewBindingParser *lookup_parser(ViewBindingState *state,
+					const gchar *element_name);
 
-static void destroy_class_id(ClassId *class_id);
+static void destroy_object_bindings(ObjectBindings **object_bindings);
 
 static void destroy_signal_array(GArray **signal_array);
 
-static void handle_object_attribute(const gchar *element_name,
+static void handle_object_attribute(GStringChunk *arena,
+				    const gchar *element_name,
 				    const gchar **attribute_names,
 				    const gchar **attribute_values,
 				    gpointer user_data);
 
-static void handle_signal_attribute(const gchar *element_name,
+static void handle_object_end(const gchar *element_name, gpointer user_data);
+
+static void handle_signal_attribute(GStringChunk *arena,
+				    const gchar *element_name,
 				    const gchar **attribute_names,
 				    const gchar **attribute_values,
 				    gpointer user_data);
 
-static void generate_code(GHashTable *view_binding_parser_map,
-			  const gchar *file_name);
+static gboolean generate_code(ViewBindingState *state, const gchar *file_name,
+			      FileStats *file_stats);
+
+static void generate_common_header(void);
+
+static void generate_depfile(GPtrArray *file_names, GPtrArray *dir_names);
+
+static void append_depfile_path(GString *output_buffer, const gchar *path);
+
+static void generate_utils_code(GString *output_buffer);
+
+static void generate_table_utils_code(GString *output_buffer);
+
+static void generate_scope_utils_code(GString *output_buffer);
+
+static gchar *get_base_string(const gchar *file_name);
+
+static gchar *get_pascal_string(const gchar *name);
+
+static gchar *get_guard_string(const gchar *file_name);
+
+static gchar *get_common_header_include(const gchar *file_name);
+
+static gchar *get_output_file_path(const gchar *file_name,
+				   const gchar *suffix);
+
+static void generate_object_code(ViewBindingOutput *output,
+				 gpointer user_data);
+
+static GArray *generate_binding_structs(GString *output_buffer,
+					const gchar *struct_name,
+					GArray *class_id_array,
+					GStringChunk *members);
+
+static void generate_binding_macros(GString *output_buffer,
+				    const gchar *base_name,
+				    const gchar *binding_type,
+				    GArray *class_id_array);
+
+static void generate_binding_table(GString *output_buffer,
+				   const gchar *base_name,
+				   const gchar *binding_type,
+				   GArray *class_id_array);
+
+static void generate_binding_entries(GString *output_buffer,
+				     const gchar *base_name,
+				     const gchar *binding_type,
+				     GArray *class_id_array);
+
+static void generate_binding_source(ViewBindingOutput *output,
+				    const gchar *binding_type,
+				    GArray *class_id_array);
+
+static void generate_ensure_types_macro(GString *output_buffer,
+					const gchar *base_name,
+					GPtrArray *type_names);
+
+static gchar *get_type_function_name(const gchar *type_name);
+
+static gboolean is_mangling_upper(gchar c);
+
+static void generate_signal_code(ViewBindingOutput *output,
+				 gpointer user_data);
+
+static void generate_callback_scope(GString *output_buffer,
+				    const gchar *base_name,
+				    GPtrArray *signals);
+
+static gint compare_signal_handlers(gconstpointer a, gconstpointer b);
+
+static gboolean write_output_file(const gchar *file_path,
+				  const GString *content, GError **error);
+
+static void output_writer_init(OutputWriter *writer, const gchar *file_path,
+			       GString *buffer);
+
+static gboolean output_writer_flush(OutputWriter *writer);
+
+static gboolean output_writer_open(OutputWriter *writer, GError **error);
+
+static gboolean output_writer_close(OutputWriter *writer, gboolean commit);
+
+static gboolean write_standard_output(const GString *content, GError **error);
+
+static gboolean output_file_is_unchanged(const gchar *file_path,
+					 const GString *content);
+
+static gchar *get_cache_options(void);
+
+static void load_cache_manifest(void);
+
+static GKeyFile *load_manifest_file(const gchar *manifest_path);
+
+static void keep_warm_manifest(const gchar *manifest_path);
+
+static void save_cache_manifest(GPtrArray *file_names);
+
+static gchar *get_manifest_path(void);
+
+static gboolean file_in_shard(const gchar *file_name);
 
-static void generate_object_code(const gchar *base_name, gpointer user_data);
+static gboolean merge_shard_manifests(void);
 
-static void generate_signal_code(const gchar *base_name, gpointer user_data);
+static gboolean query_input_file(const gchar *file_path, guint64 *size,
+				 guint64 *mtime);
 
-static void hash_table_for_each(gpointer key, gpointer value,
-				gpointer user_data);
+static gboolean cache_entry_is_fresh(const gchar *file_name, guint64 size,
+				     guint64 mtime, const gchar *checksum);
 
-static gchar *replace_hyphen_to_underscore_dup(const gchar *input);
+static void cache_entry_update(const gchar *file_name, guint64 size,
+			       guint64 mtime, const gchar *checksum);
+
+static void cache_entry_remove(const gchar *file_name);
+
+static gchar **cache_entry_get_structs(const gchar *file_name);
+
+static void cache_entry_set_structs(const gchar *file_name,
+				    gchar **structs);
+
+static const gchar *arena_insert_identifier(GStringChunk *arena,
+					    const gchar *input);
+
+static void record_file_stats(const FileStats *file_stats);
+
+static gint compare_file_stats(gconstpointer a, gconstpointer b);
+
+static void print_stats(void);
+
+static void write_stats_json(void);
+
+static void append_json_string(GString *output_buffer, const gchar *value);
+
+static void clear_file_stats(FileStats *file_stats);
+
+static AllocPhase enter_alloc_phase(AllocPhase phase);
+
+static gboolean start_alloc_accounting(void);
+
+static gboolean print_alloc_stats(void);
+
+static gint count_parser_data(void);
 
 static gchar *application_id = NULL;
 static gchar *directory = NULL;
 static gchar *output_directory = NULL;
+static gboolean recursive = FALSE;
+static gint jobs = 1;
+static gboolean always_write = FALSE;
+static gboolean no_cache = FALSE;
+static gchar *shard_spec = NULL;
+static guint shard_index = 0;
+static guint shard_count = 1;
+static gboolean merge_manifests = FALSE;
+static gchar *read_mode_name = NULL;
+static ReadMode read_mode = READ_MODE_MMAP;
+static gint chunk_size = 64 * 1024;
+static gchar *engine_name = NULL;
+static ParseEngine engine = PARSE_ENGINE_MARKUP;
+static gchar *binding_style_name = NULL;
+static BindingStyle binding_style = BINDING_STYLE_MACRO;
+static gchar *struct_layout_name = NULL;
+static StructLayout struct_layout = STRUCT_LAYOUT_FLAT;
+static gchar *output_mode_name = NULL;
+static OutputMode output_mode = OUTPUT_MODE_REPLACE;
+static gboolean no_fsync = FALSE;
+static gboolean emit_source = FALSE;
+static gboolean common_header = FALSE;
+static gboolean callback_scope = FALSE;
+static gboolean minify_ui = FALSE;
+static gchar **bind_include = NULL;
+static gchar **bind_exclude = NULL;
+// GPatternSpec, compiled from the options above
+static GPtrArray *bind_include_specs = NULL;
+static GPtrArray *bind_exclude_specs = NULL;
+static gchar *depfile = NULL;
+static gchar *stamp_file = NULL;
+static gboolean watch = FALSE;
+static gint watch_delay = 20;
+static gboolean stats = FALSE;
+static gchar *stats_json = NULL;
+static gint stats_top = 10;
+static gboolean collect_stats = FALSE;
+static gboolean alloc_stats = FALSE;
+static gchar **input_paths = NULL;
+static gchar *stdin_name = NULL;
+// explicit inputs relative to --directory, NULL when scanning it
+static GPtrArray *input_file_names = NULL;
+static gboolean use_stdio = FALSE;
+static gchar *server_socket = NULL;
+static gchar *client_socket = NULL;
+
+static GKeyFile *cache_manifest = NULL;
+static GMutex cache_lock;
+
+static RunStats run_stats = { 0 };
+static GMutex stats_lock;
 
-static GString *output_buffer = NULL;
+/*
+ * --alloc-stats, for the whole process. Live blocks and bytes count from the
+ * start of the run, freeing older blocks takes them below zero.
+ */
+static gint alloc_accounting = FALSE; // read by the malloc replacement
+static AllocCounter alloc_counters[N_ALLOC_PHASES];
+static gssize live_blocks = 0;
+static gssize live_bytes = 0;
+static gssize peak_live_bytes = 0;
+// user_data set by the handlers, freed by destroy_view_binding_parser()
+static gint parser_data_created = 0;
+static gint parser_data_destroyed = 0;
+// ViewBindingState of every thread, whose user_data the check also counts
+static GPtrArray *parser_states = NULL;
+static GMutex parser_states_lock;
+#ifdef HAVE_ALLOC_STATS
+static __thread AllocPhase alloc_phase = ALLOC_PHASE_OTHER;
+#endif
+
+/*
+ * Output path, binding struct and macro prefix -> the file generating it,
+ * for every file of the run including unchanged ones
+ */
+static GHashTable *symbol_index = NULL;
+static GMutex symbol_lock;
+// set by the files that generate nothing because of a conflict
+static gint symbol_conflicts = 0;
+
+// --server: requests run one at a time, their output is sent to the client
+static gboolean serving = FALSE;
+static GString *captured_stdout = NULL;
+static GString *captured_stderr = NULL;
+static GMutex capture_lock;
+// absolute manifest path -> WarmManifest, NULL unless serving
+static GHashTable *warm_manifests = NULL;
+
+static GPrivate view_binding_state =
+	G_PRIVATE_INIT((GDestroyNotify)free_view_binding_state);
 
 static GOptionEntry entries[] = {
 	{ "application-id", 'a', 0, G_OPTION_ARG_STRING, &application_id,
@@ -93,18 +685,109 @@ static GOptionEntry entries[] = {
 	  "The directory to scan for UI files", "DIR" },
 	{ "output-directory", 'o', 0, G_OPTION_ARG_STRING, &output_directory,
 	  "The output directory for generated files", "DIR" },
+	{ "recursive", 'r', 0, G_OPTION_ARG_NONE, &recursive,
+	  "Also scan subdirectories, mirroring them in the output directory",
+	  NULL },
+	{ "jobs", 'j', 0, G_OPTION_ARG_INT, &jobs,
+	  "The number of files to process in parallel, 0 for one per CPU",
+	  "N" },
+	{ "always-write", 0, 0, G_OPTION_ARG_NONE, &always_write,
+	  "Rewrite generated files even when their content is unchanged",
+	  NULL },
+	{ "no-cache", 0, 0, G_OPTION_ARG_NONE, &no_cache,
+	  "Regenerate every file instead of skipping unchanged inputs", NULL },
+	{ "shard", 0, 0, G_OPTION_ARG_STRING, &shard_spec,
+	  "Only process the UI files of shard I of N (counting from 0), chosen by a hash of their names",
+	  "I/N" },
+	{ "merge-manifests", 0, 0, G_OPTION_ARG_NONE, &merge_manifests,
+	  "Merge the manifests written by --shard in the output directory into one and exit",
+	  NULL },
+	{ "read-mode", 0, 0, G_OPTION_ARG_STRING, &read_mode_name,
+	  "How to load UI files: mmap (default), read or stream", "MODE" },
+	{ "chunk-size", 0, 0, G_OPTION_ARG_INT, &chunk_size,
+	  "The number of bytes fed to the parser at a time in stream mode",
+	  "BYTES" },
+	{ "engine", 0, 0, G_OPTION_ARG_STRING, &engine_name,
+	  "How UI files are parsed: markup (default, validating) or fast",
+	  "ENGINE" },
+	{ "binding-style", 0, 0, G_OPTION_ARG_STRING, &binding_style_name,
+	  "How children are bound: macro (default) or table", "STYLE" },
+	{ "struct-layout", 0, 0, G_OPTION_ARG_STRING, &struct_layout_name,
+	  "Binding struct layout: flat (default) or nested, with a sub-struct per outermost object",
+	  "LAYOUT" },
+	{ "output-mode", 0, 0, G_OPTION_ARG_STRING, &output_mode_name,
+	  "How generated files are written: replace (default, atomic) or stream (in place, as the code is generated)",
+	  "MODE" },
+	{ "no-fsync", 0, 0, G_OPTION_ARG_NONE, &no_fsync,
+	  "Write files in place without syncing them to disk, for build directories that need not survive a crash",
+	  NULL },
+	{ "emit-source", 0, 0, G_OPTION_ARG_NONE, &emit_source,
+	  "Also write a .c file holding the binding registration functions",
+	  NULL },
+	{ "common-header", 0, 0, G_OPTION_ARG_NONE, &common_header,
+	  "Write the shared helpers once to " COMMON_HEADER_NAME
+	  " and include it from every generated file",
+	  NULL },
+	{ "callback-scope", 0, 0, G_OPTION_ARG_NONE, &callback_scope,
+	  "Bind signal handlers through a builder scope holding a sorted handler table",
+	  NULL },
+	{ "minify-ui", 0, 0, G_OPTION_ARG_NONE, &minify_ui,
+	  "Also write a minified copy of every UI file, named <base>.min.ui, next to its header",
+	  NULL },
+	{ "bind-include", 0, 0, G_OPTION_ARG_STRING_ARRAY, &bind_include,
+	  "Only bind objects whose id or class matches the glob PATTERN, may be repeated",
+	  "PATTERN" },
+	{ "bind-exclude", 0, 0, G_OPTION_ARG_STRING_ARRAY, &bind_exclude,
+	  "Do not bind objects whose id or class matches the glob PATTERN, may be repeated",
+	  "PATTERN" },
+	{ "depfile", 0, 0, G_OPTION_ARG_FILENAME, &depfile,
+	  "Write Makefile style dependencies of the generated files to FILE",
+	  "FILE" },
+	{ "stamp", 0, 0, G_OPTION_ARG_FILENAME, &stamp_file,
+	  "The stamp file touched after each run and listed in the depfile, "
+	  "defaults to viewbinding.stamp in the output directory",
+	  "FILE" },
+	{ "watch", 'w', 0, G_OPTION_ARG_NONE, &watch,
+	  "Keep running and regenerate UI files as they change", NULL },
+	{ "watch-delay", 0, 0, G_OPTION_ARG_INT, &watch_delay,
+	  "Milliseconds to wait for further changes before regenerating a file in watch mode (default 20)",
+	  "MS" },
+	{ "stats", 0, 0, G_OPTION_ARG_NONE, &stats,
+	  "Print the time spent in each phase and the slowest files", NULL },
+	{ "stats-json", 0, 0, G_OPTION_ARG_FILENAME, &stats_json,
+	  "Write the phase times and per-file counters as JSON to FILE",
+	  "FILE" },
+	{ "stats-top", 0, 0, G_OPTION_ARG_INT, &stats_top,
+	  "The number of slowest files listed by --stats (default 10)", "N" },
+	{ "alloc-stats", 0, 0, G_OPTION_ARG_NONE, &alloc_stats,
+	  "Print the allocations of each phase, the peak heap and RSS, and what is still allocated after teardown",
+	  NULL },
+	{ "stdin-name", 0, 0, G_OPTION_ARG_FILENAME, &stdin_name,
+	  "The name of the UI file read from standard input, which names the generated code",
+	  "NAME" },
+	{ "server", 0, 0, G_OPTION_ARG_FILENAME, &server_socket,
+	  "Keep running and serve --client requests on the Unix socket SOCKET",
+	  "SOCKET" },
+	{ "client", 0, 0, G_OPTION_ARG_FILENAME, &client_socket,
+	  "Let the server on SOCKET run this command, running it here when no server answers",
+	  "SOCKET" },
+	{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &input_paths,
+	  "UI files to process instead of scanning the directory, @FILE to read their paths from FILE, or - for standard input",
+	  "[FILE.ui|@FILE|-...]" },
 	{ NULL }
 };
 
-static ViewBindingParser class_parser = {
+// Parser templates, copied into each thread's state before its first file
+static const ViewBindingParser class_parser = {
 	.element_name = "object",
 	.handle_attribute = handle_object_attribute,
+	.handle_end = handle_object_end,
 	.generate_code = generate_object_code,
-	.destroy_user_data = (GDestroyNotify)destroy_list_class_id,
+	.destroy_user_data = (GDestroyNotify)destroy_object_bindings,
 	.user_data = NULL,
 };
 
-static ViewBindingParser signal_parser = {
+static const ViewBindingParser signal_parser = {
 	.element_name = "signal",
 	.handle_attribute = handle_signal_attribute,
 	.generate_code = generate_signal_code,
@@ -112,449 +795,4572 @@ static ViewBindingParser signal_parser = {
 	.user_data = NULL,
 };
 
+static const ViewBindingParser *const parser_templates[N_PARSERS] = {
+	[PARSER_OBJECT] = &class_parser,
+	[PARSER_SIGNAL] = &signal_parser,
+};
+
 static GMarkupParser xml_parser = {
 	.start_element = start,
+	.end_element = end_element,
+	.passthrough = passthrough,
+};
+
+// --minify-ui: the same walk also rebuilds the document
+static GMarkupParser minify_xml_parser = {
+	.start_element = minify_start,
+	.end_element = minify_end,
+	.text = minify_text,
+	.passthrough = minify_passthrough,
 };
 
 int main(int argc, char *argv[])
 {
-	parse_arguments(argc, argv);
-	check_arguments();
+	g_auto(GStrv) arguments = g_strdupv(argv);
+	int status = EXIT_SUCCESS;
 
-	// Scan the directory for .ui files
-	g_autoptr(GDir) dir = g_dir_open(directory, 0, NULL);
-	const gchar *name = NULL;
-	while ((name = g_dir_read_name(dir)) != NULL) {
-		if (!g_str_has_suffix(name, ".ui")) {
-			continue;
-		}
-		read_and_parse_xml_file(name);
-	}
+	parse_arguments(arguments);
+	if (server_socket)
+		status = run_server();
+	else if (client_socket == NULL || !run_client(arguments, &status))
+		status = run_generator();
 
-	// Clean up
-	if (application_id)
-		g_free(application_id);
-	if (directory)
-		g_free(directory);
-	if (output_directory)
-		g_free(output_directory);
-	return 0;
+	g_private_replace(&view_binding_state, NULL);
+	return status;
 }
 
-static void parse_arguments(int argc, char *argv[])
+static void parse_arguments(gchar **arguments)
 {
 	g_autoptr(GOptionContext)
 		context = g_option_context_new("- View Binding Code Generator");
 	g_autoptr(GError) error = NULL;
+	g_auto(GStrv) remaining = g_strdupv(arguments);
 
 	g_option_context_add_main_entries(context, entries, NULL);
-	if (!g_option_context_parse(context, &argc, &argv, &error)) {
+	// --help would exit the server
+	g_option_context_set_help_enabled(context, !serving);
+	if (!g_option_context_parse_strv(context, &remaining, &error)) {
 		g_printerr("Error parsing options: %s\n", error->message);
 	}
 }
 
-static void check_arguments(void)
+/*
+ * Frees the options and puts every option and per-run variable back to its
+ * initial value, so that the server starts each request afresh. Keep it in
+ * line with the definitions.
+ */
+static void reset_options(void)
 {
-	g_autoptr(GError) error = NULL;
-	if (application_id == NULL) {
-		g_printerr("Error: --application-id is required.\n");
-		exit(EXIT_FAILURE);
-	}
-	g_autoptr(GRegex) regex = g_regex_new("^[a-zA-Z][\\w]+_[\\w]+_[\\w]+$",
-					      G_REGEX_OPTIMIZE, 0, &error);
-	if (!g_regex_match(regex, application_id, 0, NULL)) {
-		g_printerr(
-			"application-id '%s' is not valid. It must be in the format com_example_AppName\n",
-			application_id);
-		exit(EXIT_FAILURE);
-	}
+	g_clear_pointer(&cache_manifest, g_key_file_unref);
+	g_clear_pointer(&application_id, g_free);
+	g_clear_pointer(&directory, g_free);
+	g_clear_pointer(&output_directory, g_free);
+	g_clear_pointer(&read_mode_name, g_free);
+	g_clear_pointer(&engine_name, g_free);
+	g_clear_pointer(&binding_style_name, g_free);
+	g_clear_pointer(&struct_layout_name, g_free);
+	g_clear_pointer(&output_mode_name, g_free);
+	g_clear_pointer(&shard_spec, g_free);
+	g_clear_pointer(&depfile, g_free);
+	g_clear_pointer(&stamp_file, g_free);
+	g_clear_pointer(&stats_json, g_free);
+	g_clear_pointer(&stdin_name, g_free);
+	g_clear_pointer(&server_socket, g_free);
+	g_clear_pointer(&client_socket, g_free);
+	g_clear_pointer(&input_paths, g_strfreev);
+	g_clear_pointer(&input_file_names, g_ptr_array_unref);
+	g_clear_pointer(&bind_include, g_strfreev);
+	g_clear_pointer(&bind_exclude, g_strfreev);
+	g_clear_pointer(&bind_include_specs, g_ptr_array_unref);
+	g_clear_pointer(&bind_exclude_specs, g_ptr_array_unref);
+	g_clear_pointer(&run_stats.files, g_array_unref);
+	run_stats = (RunStats){ 0 };
+	g_clear_pointer(&symbol_index, g_hash_table_unref);
+	symbol_conflicts = 0;
 
-	if (directory == NULL) {
-		g_printerr("Error: --directory is required.\n");
-		exit(EXIT_FAILURE);
-	}
-	if (!g_file_test(directory, G_FILE_TEST_IS_DIR)) {
-		g_printerr(
-			"Error: --directory '%s' is not a valid directory.\n",
-			directory);
-		exit(EXIT_FAILURE);
+	recursive = FALSE;
+	jobs = 1;
+	always_write = FALSE;
+	no_cache = FALSE;
+	shard_index = 0;
+	shard_count = 1;
+	merge_manifests = FALSE;
+	read_mode = READ_MODE_MMAP;
+	chunk_size = 64 * 1024;
+	engine = PARSE_ENGINE_MARKUP;
+	binding_style = BINDING_STYLE_MACRO;
+	struct_layout = STRUCT_LAYOUT_FLAT;
+	output_mode = OUTPUT_MODE_REPLACE;
+	no_fsync = FALSE;
+	emit_source = FALSE;
+	common_header = FALSE;
+	callback_scope = FALSE;
+	minify_ui = FALSE;
+	watch = FALSE;
+	watch_delay = 20;
+	stats = FALSE;
+	stats_top = 10;
+	collect_stats = FALSE;
+	alloc_stats = FALSE;
+	use_stdio = FALSE;
+}
+
+static int run_generator(void)
+{
+	int status = EXIT_SUCCESS;
+
+	if (!check_arguments())
+		status = EXIT_FAILURE;
+	else if (merge_manifests && !merge_shard_manifests())
+		status = EXIT_FAILURE;
+	else if (!merge_manifests && !generate_all())
+		status = EXIT_FAILURE;
+
+	if (g_atomic_int_get(&alloc_accounting) && !print_alloc_stats())
+		status = EXIT_FAILURE;
+	reset_options();
+	return status;
+}
+
+// Fails when files conflict, other errors only skip the file
+static gboolean generate_all(void)
+{
+	g_autoptr(GPtrArray) file_names =
+		g_ptr_array_new_with_free_func(g_free);
+	g_autoptr(GPtrArray) dir_names = g_ptr_array_new_with_free_func(g_free);
+	const gint64 start_time = g_get_monotonic_time();
+	gint64 phase_start = start_time;
+
+	symbol_index = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+					     g_free);
+	load_cache_manifest();
+	run_stats.cache_usec += g_get_monotonic_time() - phase_start;
+	if (common_header)
+		generate_common_header();
+	process_files(file_names, dir_names);
+	phase_start = g_get_monotonic_time();
+	save_cache_manifest(file_names);
+	run_stats.cache_usec += g_get_monotonic_time() - phase_start;
+	if (depfile) {
+		phase_start = g_get_monotonic_time();
+		generate_depfile(file_names, dir_names);
+		run_stats.depfile_usec = g_get_monotonic_time() - phase_start;
 	}
 
-	if (output_directory == NULL) {
-		g_printerr("Error: --output-directory is required.\n");
-		exit(EXIT_FAILURE);
+	if (collect_stats) {
+		run_stats.wall_usec = g_get_monotonic_time() - start_time;
+		if (stats)
+			print_stats();
+		if (stats_json)
+			write_stats_json();
+		// watch mode regenerations are not reported
+		collect_stats = FALSE;
+		g_clear_pointer(&run_stats.files, g_array_unref);
 	}
-	if (g_file_test(output_directory, G_FILE_TEST_EXISTS)) {
-		if (!g_file_test(output_directory, G_FILE_TEST_IS_DIR)) {
-			g_printerr(
-				"Error: --output-directory '%s' is not a valid directory.\n",
-				output_directory);
-			exit(EXIT_FAILURE);
-		}
-	} else {
-		// create the output directory
-		if (g_mkdir_with_parents(output_directory, 0755) != 0) {
+
+	if (watch)
+		watch_directory(file_names, dir_names);
+	return g_atomic_int_get(&symbol_conflicts) == 0;
+}
+
+/*
+ * Serves requests until SIGINT or SIGTERM. Each request runs in this process
+ * with the client's arguments and working directory. Interned names, the
+ * compiled application id pattern, the worker threads with their parser
+ * state and the manifests it wrote stay in memory between requests.
+ */
+static int run_server(void)
+{
+	// requests change the working directory
+	g_autofree gchar *socket_path =
+		g_canonicalize_filename(server_socket, NULL);
+	g_autoptr(GSocketAddress) address =
+		g_unix_socket_address_new(socket_path);
+	g_autoptr(GSocketService) service = g_socket_service_new();
+	g_autoptr(GMainLoop) loop = g_main_loop_new(NULL, FALSE);
+	g_autoptr(GError) error = NULL;
+
+	// options next to --server do not apply to the requests
+	reset_options();
+
+	if (g_file_test(socket_path, G_FILE_TEST_EXISTS)) {
+		g_autoptr(GSocketClient) client = g_socket_client_new();
+		g_autoptr(GSocketConnection) connection =
+			g_socket_client_connect(client,
+						G_SOCKET_CONNECTABLE(address),
+						NULL, NULL);
+
+		if (connection) {
 			g_printerr(
-				"Error: could not create output directory '%s'.\n",
-				output_directory);
-			exit(EXIT_FAILURE);
+				"Error: a server is already listening on %s.\n",
+				socket_path);
+			return EXIT_FAILURE;
 		}
+		// left behind by a server that did not shut down
+		g_unlink(socket_path);
+	}
+#ifdef G_OS_UNIX
+	// only this user may connect, the socket is created 0600
+	const mode_t mask = umask(0177);
+#endif
+	const gboolean listening = g_socket_listener_add_address(
+		G_SOCKET_LISTENER(service), address, G_SOCKET_TYPE_STREAM,
+		G_SOCKET_PROTOCOL_DEFAULT, NULL, NULL, &error);
+#ifdef G_OS_UNIX
+	umask(mask);
+#endif
+	if (!listening) {
+		g_printerr("Error listening on %s: %s\n", socket_path,
+			   error->message);
+		return EXIT_FAILURE;
 	}
+
+	serving = TRUE;
+	warm_manifests = g_hash_table_new_full(
+		g_str_hash, g_str_equal, g_free,
+		(GDestroyNotify)free_warm_manifest);
+	// finished pools leave their threads, and so their parser state, to
+	// the next request
+	g_thread_pool_set_max_unused_threads(-1);
+	g_thread_pool_set_max_idle_time(0);
+
+	g_signal_connect(service, "incoming", G_CALLBACK(on_server_request),
+			 NULL);
+#ifdef G_OS_UNIX
+	g_unix_signal_add(SIGINT, quit_main_loop, loop);
+	g_unix_signal_add(SIGTERM, quit_main_loop, loop);
+#endif
+	g_socket_service_start(service);
+	g_main_loop_run(loop);
+
+	g_socket_service_stop(service);
+	g_socket_listener_close(G_SOCKET_LISTENER(service));
+	g_unlink(socket_path);
+	g_clear_pointer(&warm_manifests, g_hash_table_unref);
+	serving = FALSE;
+	return EXIT_SUCCESS;
 }
 
-static void read_and_parse_xml_file(const gchar *file_name)
+/*
+ * A request is a count followed by the client's working directory and its
+ * arguments, the reply the exit status and what the run printed to stdout
+ * and stderr. Strings are sent as a length and the bytes.
+ */
+static gboolean on_server_request(GSocketService *service,
+				  GSocketConnection *connection,
+				  GObject *source_object, gpointer user_data)
 {
-	g_autoptr(GMarkupParseContext) context = NULL;
-	g_autoptr(GHashTable) view_binding_parser_map = NULL;
+	g_autoptr(GDataInputStream) input = g_data_input_stream_new(
+		g_io_stream_get_input_stream(G_IO_STREAM(connection)));
+	g_autoptr(GDataOutputStream) output = g_data_output_stream_new(
+		g_io_stream_get_output_stream(G_IO_STREAM(connection)));
+	g_autoptr(GPtrArray) arguments = g_ptr_array_new_with_free_func(g_free);
 	g_autoptr(GError) error = NULL;
-	g_autofree gchar *file_path =
-		g_build_filename(directory, file_name, NULL);
-	g_autofree gchar *xml_content = NULL;
-	gsize file_size = 0;
+	guint32 count = 0;
+	int status = EXIT_SUCCESS;
 
-	g_file_get_contents(file_path, &xml_content, &file_size, &error);
+	count = g_data_input_stream_read_uint32(input, NULL, &error);
+	// closed without a request, like a second server checking for us
+	if (error)
+		return TRUE;
+	for (guint i = 0; i < count && error == NULL; i++)
+		g_ptr_array_add(arguments,
+				read_message_string(input, NULL, &error));
+	if (error == NULL && count < 2)
+		g_set_error_literal(&error, G_IO_ERROR, G_IO_ERROR_FAILED,
+				    "Request without arguments");
 	if (error) {
-		g_printerr("Error reading file %s: %s\n", file_path,
-			   error->message);
-		g_error_free(error);
-		error = NULL;
-		return;
+		g_printerr("Error reading request: %s\n", error->message);
+		return TRUE;
 	}
+	g_ptr_array_add(arguments, NULL);
+
+	captured_stdout = g_string_new(NULL);
+	captured_stderr = g_string_new(NULL);
+	status = serve_request((gchar **)arguments->pdata);
 
-	view_binding_parser_map = g_hash_table_new_full(
-		g_str_hash, g_str_equal, NULL,
-		(GDestroyNotify)destroy_view_binding_parser);
-	g_hash_table_insert(view_binding_parser_map, class_parser.element_name,
-			    &class_parser);
-	g_hash_table_insert(view_binding_parser_map, signal_parser.element_name,
-			    &signal_parser);
+	if (!g_data_output_stream_put_int32(output, status, NULL, &error) ||
+	    !write_message_string(output, captured_stdout->str,
+				  captured_stdout->len, &error) ||
+	    !write_message_string(output, captured_stderr->str,
+				  captured_stderr->len, &error))
+		g_printerr("Error sending reply: %s\n", error->message);
+	g_string_free(g_steal_pointer(&captured_stdout), TRUE);
+	g_string_free(g_steal_pointer(&captured_stderr), TRUE);
+	return TRUE;
+}
 
-	context = g_markup_parse_context_new(&xml_parser, 0,
-					     &view_binding_parser_map, NULL);
+static int serve_request(gchar **arguments)
+{
+	GPrintFunc print_func = g_set_print_handler(capture_print);
+	GPrintFunc printerr_func = g_set_printerr_handler(capture_printerr);
+	int status = EXIT_FAILURE;
 
-	if (!g_markup_parse_context_parse(context, xml_content, file_size,
-					  &error)) {
-		g_printerr("Error parsing XML file %s: %s\n", file_path,
-			   error ? error->message : "Unknown error");
-		if (error) {
-			g_error_free(error);
-			error = NULL;
+	if (g_chdir(arguments[0]) != 0) {
+		g_printerr("Error: cannot change to directory %s: %s\n",
+			   arguments[0], g_strerror(errno));
+	} else {
+		parse_arguments(arguments + 1);
+		if (server_socket || client_socket || watch) {
+			g_printerr(
+				"Error: --server, --client and --watch cannot be sent to a server.\n");
+			reset_options();
+		} else {
+			status = run_generator();
 		}
-		return;
 	}
 
-	generate_code(view_binding_parser_map, file_name);
+	g_set_print_handler(print_func);
+	g_set_printerr_handler(printerr_func);
+	return status;
 }
 
-static void start(GMarkupParseContext *context, const gchar *element_name,
-		  const gchar **attribute_names, const gchar **attribute_values,
-		  gpointer user_data, GError **error)
+// Workers print too, so the captured output is locked
+static void capture_print(const gchar *string)
 {
-	GHashTable **view_binding_parser_map = (GHashTable **)user_data;
-	ViewBindingParser *parser =
-		g_hash_table_lookup(*view_binding_parser_map, element_name);
-	if (parser && parser->handle_attribute)
-		parser->handle_attribute(element_name, attribute_names,
-					 attribute_values, &parser->user_data);
+	g_mutex_lock(&capture_lock);
+	g_string_append(captured_stdout, string);
+	g_mutex_unlock(&capture_lock);
 }
 
-static void destroy_view_binding_parser(ViewBindingParser *parser)
+static void capture_printerr(const gchar *string)
 {
-	if (parser->destroy_user_data && parser->user_data)
-		parser->destroy_user_data(&parser->user_data);
-	parser->user_data = NULL;
+	g_mutex_lock(&capture_lock);
+	g_string_append(captured_stderr, string);
+	g_mutex_unlock(&capture_lock);
 }
 
-static void destroy_list_class_id(GList **class_id_list)
+/*
+ * Sends the arguments without --client to the server and replays its reply.
+ * Returns FALSE when the command should run here instead: no server answers,
+ * or the command reads standard input or watches. Once connected the server
+ * may have run the request, so a failure afterwards fails the command
+ * rather than running it a second time.
+ */
+static gboolean run_client(gchar **arguments, int *status)
 {
-	g_list_free_full(*class_id_list, (GDestroyNotify)destroy_class_id);
-}
+	g_autoptr(GSocketAddress) address =
+		g_unix_socket_address_new(client_socket);
+	g_autoptr(GSocketClient) client = g_socket_client_new();
+	g_autoptr(GSocketConnection) connection = NULL;
+	g_autoptr(GDataInputStream) input = NULL;
+	g_autoptr(GDataOutputStream) output = NULL;
+	g_autoptr(GPtrArray) forwarded = g_ptr_array_new_with_free_func(g_free);
+	g_autofree gchar *stdout_data = NULL;
+	g_autofree gchar *stderr_data = NULL;
+	g_autoptr(GError) error = NULL;
+	gsize stdout_length = 0;
+	gsize stderr_length = 0;
+	gint32 reply_status = 0;
+	gboolean sent = TRUE;
 
-static void destroy_class_id(ClassId *class_id)
-{
-	if (class_id) {
-		g_free(class_id->class);
-		g_free(class_id->id);
-		g_free(class_id);
-	}
-}
+	if (watch || (input_paths && g_strv_contains(
+					      (const gchar *const *)input_paths,
+					      "-")))
+		return FALSE;
+	connection = g_socket_client_connect(
+		client, G_SOCKET_CONNECTABLE(address), NULL, NULL);
+	if (connection == NULL)
+		return FALSE;
 
-static void destroy_signal_array(GArray **signal_array)
-{
-	if (signal_array == NULL || *signal_array == NULL)
+	g_ptr_array_add(forwarded, g_get_current_dir());
+	for (gchar **argument = arguments; *argument; argument++) {
+		if (g_strcmp0(*argument, "--") == 0) {
+			for (; *argument; argument++)
+				g_ptr_array_add(forwarded, g_strdup(*argument));
+			break;
+		}
+		if (g_strcmp0(*argument, "--client") == 0 && argument[1]) {
+			argument++;
+			continue;
+		}
+		if (!g_str_has_prefix(*argument, "--client="))
+			g_ptr_array_add(forwarded, g_strdup(*argument));
+	}
+
+	input = g_data_input_stream_new(
+		g_io_stream_get_input_stream(G_IO_STREAM(connection)));
+	output = g_data_output_stream_new(
+		g_io_stream_get_output_stream(G_IO_STREAM(connection)));
+	sent = g_data_output_stream_put_uint32(output, forwarded->len, NULL,
+					       &error);
+	for (guint i = 0; i < forwarded->len && sent; i++) {
+		const gchar *argument = g_ptr_array_index(forwarded, i);
+		sent = write_message_string(output, argument, strlen(argument),
+					    &error);
+	}
+	if (sent)
+		reply_status = g_data_input_stream_read_int32(input, NULL,
+							      &error);
+	if (error == NULL)
+		stdout_data = read_message_string(input, &stdout_length,
+						  &error);
+	if (error == NULL)
+		stderr_data = read_message_string(input, &stderr_length,
+						  &error);
+	if (error) {
+		g_printerr("Error talking to server %s: %s\n", client_socket,
+			   error->message);
+		*status = EXIT_FAILURE;
+		reset_options();
+		return TRUE;
+	}
+
+	fwrite(stdout_data, 1, stdout_length, stdout);
+	fwrite(stderr_data, 1, stderr_length, stderr);
+	*status = reply_status;
+	reset_options();
+	return TRUE;
+}
+
+static gboolean write_message_string(GDataOutputStream *stream,
+				     const gchar *data, gsize length,
+				     GError **error)
+{
+	return g_data_output_stream_put_uint32(stream, length, NULL, error) &&
+	       g_output_stream_write_all(G_OUTPUT_STREAM(stream), data, length,
+					 NULL, NULL, error);
+}
+
+// NUL terminated, the length is optional
+static gchar *read_message_string(GDataInputStream *stream, gsize *length,
+				  GError **error)
+{
+	g_autofree gchar *data = NULL;
+	GError *read_error = NULL;
+	gsize bytes_read = 0;
+	guint32 size = g_data_input_stream_read_uint32(stream, NULL,
+						       &read_error);
+
+	if (read_error) {
+		g_propagate_error(error, read_error);
+		return NULL;
+	}
+	if (size > MESSAGE_MAX_LENGTH) {
+		g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED,
+			    "Message of %u bytes is too long", size);
+		return NULL;
+	}
+
+	data = g_malloc(size + 1);
+	if (!g_input_stream_read_all(G_INPUT_STREAM(stream), data, size,
+				     &bytes_read, NULL, error))
+		return NULL;
+	if (bytes_read != size) {
+		g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED,
+				    "Connection closed in the middle of a message");
+		return NULL;
+	}
+	data[size] = '\0';
+	if (length)
+		*length = size;
+	return g_steal_pointer(&data);
+}
+
+static void free_warm_manifest(WarmManifest *warm_manifest)
+{
+	g_key_file_unref(warm_manifest->key_file);
+	g_free(warm_manifest);
+}
+
+static gboolean check_arguments(void)
+{
+	g_autoptr(GError) error = NULL;
+
+	// merging only reads and writes manifests
+	if (merge_manifests) {
+		if (output_directory == NULL ||
+		    !g_file_test(output_directory, G_FILE_TEST_IS_DIR)) {
+			g_printerr(
+				"Error: --merge-manifests needs an existing --output-directory.\n");
+			return FALSE;
+		}
+		if (shard_spec || input_paths) {
+			g_printerr(
+				"Error: --merge-manifests does not process UI files, drop --shard and UI file paths.\n");
+			return FALSE;
+		}
+		return TRUE;
+	}
+
+	if (application_id == NULL) {
+		g_printerr("Error: --application-id is required.\n");
+		return FALSE;
+	}
+	// compiled once, the server checks every request
+	static GRegex *regex = NULL;
+	if (regex == NULL)
+		regex = g_regex_new("^[a-zA-Z][\\w]+_[\\w]+_[\\w]+$",
+				    G_REGEX_OPTIMIZE, 0, &error);
+	if (!g_regex_match(regex, application_id, 0, NULL)) {
+		g_printerr(
+			"application-id '%s' is not valid. It must be in the format com_example_AppName\n",
+			application_id);
+		return FALSE;
+	}
+
+	use_stdio = input_paths && g_strcmp0(input_paths[0], "-") == 0 &&
+		    input_paths[1] == NULL;
+	// explicit inputs are named relative to the current directory by
+	// default
+	if (directory == NULL && input_paths)
+		directory = g_strdup(".");
+	if (output_directory == NULL && use_stdio)
+		output_directory = g_strdup(".");
+
+	if (directory == NULL) {
+		g_printerr("Error: --directory is required.\n");
+		return FALSE;
+	}
+	if (!g_file_test(directory, G_FILE_TEST_IS_DIR)) {
+		g_printerr(
+			"Error: --directory '%s' is not a valid directory.\n",
+			directory);
+		return FALSE;
+	}
+
+	// before the inputs, which switch standard input away from streaming
+	if (read_mode_name == NULL || g_strcmp0(read_mode_name, "mmap") == 0) {
+		read_mode = READ_MODE_MMAP;
+	} else if (g_strcmp0(read_mode_name, "read") == 0) {
+		read_mode = READ_MODE_READ;
+	} else if (g_strcmp0(read_mode_name, "stream") == 0) {
+		read_mode = READ_MODE_STREAM;
+	} else {
+		g_printerr(
+			"Error: --read-mode '%s' is not valid. It must be mmap, read or stream.\n",
+			read_mode_name);
+		return FALSE;
+	}
+
+	if (input_paths && !expand_input_paths())
+		return FALSE;
+
+	if (output_directory == NULL) {
+		g_printerr("Error: --output-directory is required.\n");
+		return FALSE;
+	}
+	if (g_file_test(output_directory, G_FILE_TEST_EXISTS)) {
+		if (!g_file_test(output_directory, G_FILE_TEST_IS_DIR)) {
+			g_printerr(
+				"Error: --output-directory '%s' is not a valid directory.\n",
+				output_directory);
+			return FALSE;
+		}
+	} else {
+		// create the output directory
+		if (g_mkdir_with_parents(output_directory, 0755) != 0) {
+			g_printerr(
+				"Error: could not create output directory '%s'.\n",
+				output_directory);
+			return FALSE;
+		}
+	}
+
+	if (jobs < 0) {
+		g_printerr("Error: --jobs must not be negative.\n");
+		return FALSE;
+	}
+	if (jobs == 0)
+		jobs = (gint)g_get_num_processors();
+
+	if (shard_spec) {
+		g_auto(GStrv) parts = g_strsplit(shard_spec, "/", 2);
+		guint64 index = 0;
+		guint64 count = 0;
+
+		if (g_strv_length(parts) != 2 ||
+		    !g_ascii_string_to_unsigned(parts[1], 10, 1, G_MAXUINT,
+						&count, NULL) ||
+		    !g_ascii_string_to_unsigned(parts[0], 10, 0, count - 1,
+						&index, NULL)) {
+			g_printerr(
+				"Error: --shard '%s' is not valid. It must be I/N with 0 <= I < N.\n",
+				shard_spec);
+			return FALSE;
+		}
+		shard_index = (guint)index;
+		shard_count = (guint)count;
+	}
+	if (shard_spec && watch) {
+		g_printerr("Error: --watch cannot be combined with --shard.\n");
+		return FALSE;
+	}
+
+	if (chunk_size <= 0) {
+		g_printerr("Error: --chunk-size must be positive.\n");
+		return FALSE;
+	}
+
+	if (engine_name == NULL || g_strcmp0(engine_name, "markup") == 0) {
+		engine = PARSE_ENGINE_MARKUP;
+	} else if (g_strcmp0(engine_name, "fast") == 0) {
+		engine = PARSE_ENGINE_FAST;
+	} else {
+		g_printerr(
+			"Error: --engine '%s' is not valid. It must be markup or fast.\n",
+			engine_name);
+		return FALSE;
+	}
+	if (engine == PARSE_ENGINE_FAST && minify_ui) {
+		g_printerr(
+			"Error: --minify-ui needs the whole document, use --engine markup.\n");
+		return FALSE;
+	}
+	if (engine == PARSE_ENGINE_FAST && read_mode == READ_MODE_STREAM) {
+		g_printerr(
+			"Error: --engine fast needs the whole file, use --read-mode mmap or read.\n");
+		return FALSE;
+	}
+
+	if (output_mode_name == NULL ||
+	    g_strcmp0(output_mode_name, "replace") == 0) {
+		output_mode = OUTPUT_MODE_REPLACE;
+	} else if (g_strcmp0(output_mode_name, "stream") == 0) {
+		output_mode = OUTPUT_MODE_STREAM;
+	} else {
+		g_printerr(
+			"Error: --output-mode '%s' is not valid. It must be replace or stream.\n",
+			output_mode_name);
+		return FALSE;
+	}
+
+	if (binding_style_name == NULL ||
+	    g_strcmp0(binding_style_name, "macro") == 0) {
+		binding_style = BINDING_STYLE_MACRO;
+	} else if (g_strcmp0(binding_style_name, "table") == 0) {
+		binding_style = BINDING_STYLE_TABLE;
+	} else {
+		g_printerr(
+			"Error: --binding-style '%s' is not valid. It must be macro or table.\n",
+			binding_style_name);
+		return FALSE;
+	}
+
+	if (struct_layout_name == NULL ||
+	    g_strcmp0(struct_layout_name, "flat") == 0) {
+		struct_layout = STRUCT_LAYOUT_FLAT;
+	} else if (g_strcmp0(struct_layout_name, "nested") == 0) {
+		struct_layout = STRUCT_LAYOUT_NESTED;
+	} else {
+		g_printerr(
+			"Error: --struct-layout '%s' is not valid. It must be flat or nested.\n",
+			struct_layout_name);
+		return FALSE;
+	}
+
+	bind_include_specs = g_ptr_array_new_with_free_func(
+		(GDestroyNotify)g_pattern_spec_free);
+	bind_exclude_specs = g_ptr_array_new_with_free_func(
+		(GDestroyNotify)g_pattern_spec_free);
+	for (gchar **pattern = bind_include; pattern && *pattern; pattern++)
+		g_ptr_array_add(bind_include_specs,
+				g_pattern_spec_new(*pattern));
+	for (gchar **pattern = bind_exclude; pattern && *pattern; pattern++)
+		g_ptr_array_add(bind_exclude_specs,
+				g_pattern_spec_new(*pattern));
+
+	if (watch_delay < 0) {
+		g_printerr("Error: --watch-delay must not be negative.\n");
+		return FALSE;
+	}
+
+	if (stats_top < 0) {
+		g_printerr("Error: --stats-top must not be negative.\n");
+		return FALSE;
+	}
+	collect_stats = stats || stats_json != NULL;
+	if (collect_stats) {
+		run_stats.files = g_array_new(FALSE, TRUE, sizeof(FileStats));
+		g_array_set_clear_func(run_stats.files,
+				       (GDestroyNotify)clear_file_stats);
+	}
+
+	// shards sharing an output directory each get their own stamp
+	if (depfile && stamp_file == NULL && shard_spec) {
+		g_autofree gchar *stamp_name = g_strdup_printf(
+			"viewbinding.shard-%u-of-%u.stamp", shard_index,
+			shard_count);
+		stamp_file = g_build_filename(output_directory, stamp_name,
+					      NULL);
+	} else if (depfile && stamp_file == NULL) {
+		stamp_file = g_build_filename(output_directory,
+					      "viewbinding.stamp", NULL);
+	}
+
+	if (alloc_stats && !start_alloc_accounting()) {
+		g_printerr(
+			"Error: --alloc-stats needs a build with the alloc-stats option, on glibc and without sanitizers.\n");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/*
+ * Turns the positional arguments into file names relative to --directory,
+ * the way a scan would have found them. Paths are relative to the current
+ * directory, on the command line and in @ files alike.
+ */
+static gboolean expand_input_paths(void)
+{
+	g_autoptr(GFile) root = g_file_new_for_path(directory);
+	g_autoptr(GHashTable) seen = g_hash_table_new(g_str_hash, g_str_equal);
+
+	input_file_names = g_ptr_array_new_with_free_func(g_free);
+
+	if (use_stdio) {
+		const gchar *incompatible =
+			emit_source   ? "--emit-source" :
+			common_header ? "--common-header" :
+			depfile	      ? "--depfile" :
+			watch	      ? "--watch" :
+			stats	      ? "--stats" :
+			alloc_stats   ? "--alloc-stats" :
+			shard_spec    ? "--shard" :
+			minify_ui     ? "--minify-ui" :
+					NULL;
+
+		if (stdin_name == NULL ||
+		    !g_str_has_suffix(stdin_name, ".ui")) {
+			g_printerr(
+				"Error: reading standard input needs --stdin-name with a .ui file name.\n");
+			return FALSE;
+		}
+		if (incompatible) {
+			g_printerr(
+				"Error: %s cannot be used when writing to standard output.\n",
+				incompatible);
+			return FALSE;
+		}
+		// there is nothing to compare the input or the output with
+		no_cache = TRUE;
+		if (read_mode == READ_MODE_STREAM)
+			read_mode = READ_MODE_READ;
+		g_ptr_array_add(input_file_names, g_strdup(stdin_name));
+		return TRUE;
+	}
+	if (watch) {
+		g_printerr(
+			"Error: --watch scans --directory and cannot be combined with explicit UI files.\n");
+		return FALSE;
+	}
+
+	for (gchar **path = input_paths; *path; path++) {
+		g_autofree gchar *content = NULL;
+		g_auto(GStrv) lines = NULL;
+		g_autoptr(GError) error = NULL;
+
+		if (g_strcmp0(*path, "-") == 0) {
+			g_printerr(
+				"Error: - must be the only UI file given.\n");
+			return FALSE;
+		}
+		if ((*path)[0] != '@') {
+			if (!add_input_file(root, seen, *path))
+				return FALSE;
+			continue;
+		}
+
+		// one path per line, blank lines and # comments are skipped
+		if (!g_file_get_contents(*path + 1, &content, NULL, &error)) {
+			g_printerr("Error reading file %s: %s\n", *path + 1,
+				   error->message);
+			return FALSE;
+		}
+		lines = g_strsplit(content, "\n", -1);
+		for (gchar **line = lines; *line; line++) {
+			g_strstrip(*line);
+			if (**line != '\0' && **line != '#' &&
+			    !add_input_file(root, seen, *line))
+				return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+static gboolean add_input_file(GFile *root, GHashTable *seen,
+			       const gchar *file_path)
+{
+	g_autoptr(GFile) file = g_file_new_for_path(file_path);
+	gchar *file_name = NULL;
+
+	if (!g_str_has_suffix(file_path, ".ui")) {
+		g_printerr("Error: '%s' is not a .ui file.\n", file_path);
+		return FALSE;
+	}
+	if (!g_file_test(file_path, G_FILE_TEST_IS_REGULAR)) {
+		g_printerr("Error: UI file '%s' does not exist.\n", file_path);
+		return FALSE;
+	}
+	file_name = g_file_get_relative_path(root, file);
+	if (file_name == NULL) {
+		g_printerr(
+			"Error: UI file '%s' is not inside --directory '%s'.\n",
+			file_path, directory);
+		return FALSE;
+	}
+
+	// the same file twice would be written by two workers at once
+	if (g_hash_table_contains(seen, file_name)) {
+		g_free(file_name);
+		return TRUE;
+	}
+	g_hash_table_add(seen, file_name);
+	g_ptr_array_add(input_file_names, file_name);
+	return TRUE;
+}
+
+/*
+ * Scans the directory for .ui files and processes them. Files are queued as
+ * soon as they are found, and in recursive mode subdirectories are
+ * enumerated by a second pool, so parsing overlaps the traversal.
+ */
+static void process_files(GPtrArray *file_names, GPtrArray *dir_names)
+{
+	g_autoptr(GError) error = NULL;
+	ScanState state = {
+		.file_names = file_names,
+		.dir_names = dir_names,
+	};
+
+	if (jobs > 1) {
+		// the server's workers go back to the shared pool, with their
+		// parser state, when the request is done
+		state.file_pool = g_thread_pool_new(process_file_worker, NULL,
+						    jobs, !serving, &error);
+		if (error) {
+			g_printerr(
+				"Error creating worker pool: %s, falling back to serial mode\n",
+				error->message);
+			g_clear_error(&error);
+			if (state.file_pool)
+				g_thread_pool_free(state.file_pool, TRUE, TRUE);
+			state.file_pool = NULL;
+		}
+	}
+	if (state.file_pool && recursive && input_file_names == NULL) {
+		state.dir_pool = g_thread_pool_new(
+			scan_directory_worker, &state, jobs, FALSE, &error);
+		if (error) {
+			g_printerr(
+				"Error creating directory pool: %s, scanning serially\n",
+				error->message);
+			g_clear_error(&error);
+			state.dir_pool = NULL;
+		}
+	}
+
+	g_mutex_init(&state.lock);
+	g_cond_init(&state.dirs_done);
+
+	if (input_file_names) {
+		for (guint i = 0; i < input_file_names->len; i++)
+			queue_file(&state, g_strdup(g_ptr_array_index(
+						   input_file_names, i)));
+	} else {
+		scan_directory(&state, NULL);
+	}
+
+	// subdirectories queue further subdirectories, wait for all of them
+	g_mutex_lock(&state.lock);
+	while (state.pending_dirs > 0)
+		g_cond_wait(&state.dirs_done, &state.lock);
+	g_mutex_unlock(&state.lock);
+	if (state.dir_pool)
+		g_thread_pool_free(state.dir_pool, FALSE, TRUE);
+
+	// wait for the queued files to finish
+	if (state.file_pool)
+		g_thread_pool_free(state.file_pool, FALSE, TRUE);
+
+	g_mutex_clear(&state.lock);
+	g_cond_clear(&state.dirs_done);
+
+	// keep the manifest and depfile independent of the traversal order
+	g_ptr_array_sort(file_names, compare_file_names);
+	g_ptr_array_sort(dir_names, compare_file_names);
+}
+
+static void process_file_worker(gpointer data, gpointer user_data)
+{
+	read_and_parse_xml_file((const gchar *)data);
+}
+
+static void scan_directory(ScanState *state, const gchar *dir_name)
+{
+	g_autofree gchar *dir_path =
+		dir_name ? g_build_filename(directory, dir_name, NULL) :
+			   g_strdup(directory);
+	g_autoptr(GError) error = NULL;
+	const gint64 start_time = g_get_monotonic_time();
+	gint64 nested_usec = 0; // files and directories handled inline
+	g_autoptr(GDir) dir = g_dir_open(dir_path, 0, &error);
+	const gchar *name = NULL;
+
+	if (dir == NULL) {
+		g_printerr("Error opening directory %s: %s\n", dir_path,
+			   error->message);
+		return;
+	}
+
+	while ((name = g_dir_read_name(dir)) != NULL) {
+		gchar *relative_name =
+			dir_name ? g_build_filename(dir_name, name, NULL) :
+				   g_strdup(name);
+
+		if (is_ui_file_name(name)) {
+			nested_usec += queue_file(state, relative_name);
+			continue;
+		}
+
+		g_autofree gchar *path =
+			g_build_filename(dir_path, name, NULL);
+		// symlinks are not followed so that loops cannot occur
+		if (!recursive || g_file_test(path, G_FILE_TEST_IS_SYMLINK) ||
+		    !g_file_test(path, G_FILE_TEST_IS_DIR)) {
+			g_free(relative_name);
+			continue;
+		}
+
+		g_mutex_lock(&state->lock);
+		g_ptr_array_add(state->dir_names, relative_name);
+		if (state->dir_pool)
+			state->pending_dirs++;
+		g_mutex_unlock(&state->lock);
+
+		if (state->dir_pool == NULL) {
+			const gint64 nested_start = g_get_monotonic_time();
+			scan_directory(state, relative_name);
+			nested_usec += g_get_monotonic_time() - nested_start;
+		} else if (!g_thread_pool_push(state->dir_pool, relative_name,
+					       &error)) {
+			g_printerr("Error queueing directory %s: %s\n",
+				   relative_name, error->message);
+			g_clear_error(&error);
+			scan_directory_worker(relative_name, state);
+		}
+	}
+
+	if (collect_stats) {
+		g_mutex_lock(&stats_lock);
+		run_stats.scan_usec +=
+			g_get_monotonic_time() - start_time - nested_usec;
+		g_mutex_unlock(&stats_lock);
+	}
+}
+
+// Returns the time spent when the file had to be processed inline
+static gint64 queue_file(ScanState *state, gchar *file_name)
+{
+	g_autoptr(GError) error = NULL;
+	gint64 start_time = 0;
+
+	// files of other shards are neither processed nor listed
+	if (!file_in_shard(file_name)) {
+		g_free(file_name);
+		return 0;
+	}
+
+	g_mutex_lock(&state->lock);
+	g_ptr_array_add(state->file_names, file_name);
+	g_mutex_unlock(&state->lock);
+
+	// the array owns the name and outlives the pool
+	if (state->file_pool &&
+	    g_thread_pool_push(state->file_pool, file_name, &error))
+		return 0;
+
+	start_time = g_get_monotonic_time();
+	if (error)
+		g_printerr("Error queueing file %s: %s\n", file_name,
+			   error->message);
+	read_and_parse_xml_file(file_name);
+	return g_get_monotonic_time() - start_time;
+}
+
+/*
+ * Minified copies may share the directory with the UI files, and are left
+ * out even without --minify-ui, so a run that drops the option does not
+ * generate a binding for each of them
+ */
+static gboolean is_ui_file_name(const gchar *file_name)
+{
+	return g_str_has_suffix(file_name, ".ui") &&
+	       !g_str_has_suffix(file_name, ".min.ui");
+}
+
+static void scan_directory_worker(gpointer data, gpointer user_data)
+{
+	ScanState *state = (ScanState *)user_data;
+
+	scan_directory(state, (const gchar *)data);
+
+	g_mutex_lock(&state->lock);
+	if (--state->pending_dirs == 0)
+		g_cond_signal(&state->dirs_done);
+	g_mutex_unlock(&state->lock);
+}
+
+static gint compare_file_names(gconstpointer a, gconstpointer b)
+{
+	return g_strcmp0(*(const gchar **)a, *(const gchar **)b);
+}
+
+/*
+ * Regenerates single files as they change until interrupted. Editors
+ * usually emit several events per save, each one restarts the per-file
+ * watch_delay timeout so the file is parsed once the burst is over.
+ */
+static void watch_directory(GPtrArray *file_names, GPtrArray *dir_names)
+{
+	g_autoptr(GFile) root = g_file_new_for_path(directory);
+	g_autoptr(GPtrArray) monitors =
+		g_ptr_array_new_with_free_func(g_object_unref);
+	g_autoptr(GMainLoop) loop = g_main_loop_new(NULL, FALSE);
+	g_autoptr(GHashTable) pending_files = NULL;
+	WatchState state = {
+		.loop = loop,
+		.root = root,
+		.file_names = file_names,
+		.dir_names = dir_names,
+		.monitors = monitors,
+	};
+
+	pending_files = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+					      NULL);
+	state.pending_files = pending_files;
+
+	// one monitor per directory found by the initial scan
+	for (guint i = 0; i <= dir_names->len; i++) {
+		g_autoptr(GFile) dir =
+			i == 0 ? g_object_ref(root) :
+				 g_file_resolve_relative_path(
+					 root, g_ptr_array_index(dir_names,
+								 i - 1));
+
+		monitor_directory(&state, dir);
+	}
+	if (monitors->len == 0)
+		return;
+#ifdef G_OS_UNIX
+	g_unix_signal_add(SIGINT, quit_main_loop, loop);
+	g_unix_signal_add(SIGTERM, quit_main_loop, loop);
+#endif
+
+	g_main_loop_run(loop);
+
+	// drop timeouts still referencing the state on the stack
+	GHashTableIter iter;
+	gpointer source_id = NULL;
+	g_hash_table_iter_init(&iter, pending_files);
+	while (g_hash_table_iter_next(&iter, NULL, &source_id))
+		g_source_remove(GPOINTER_TO_UINT(source_id));
+	g_hash_table_remove_all(pending_files);
+}
+
+static gboolean monitor_directory(WatchState *state, GFile *dir)
+{
+	g_autoptr(GError) error = NULL;
+	GFileMonitor *monitor = g_file_monitor_directory(
+		dir, G_FILE_MONITOR_WATCH_MOVES, NULL, &error);
+
+	if (monitor == NULL) {
+		g_autofree gchar *dir_path = g_file_get_path(dir);
+		g_printerr("Error watching directory %s: %s\n", dir_path,
+			   error->message);
+		return FALSE;
+	}
+	g_file_monitor_set_rate_limit(monitor, watch_delay);
+	g_signal_connect(monitor, "changed", G_CALLBACK(on_directory_changed),
+			 state);
+	g_ptr_array_add(state->monitors, monitor);
+	return TRUE;
+}
+
+/*
+ * A subdirectory created or moved in while watching recursively gets a
+ * monitor of its own. Whatever it already holds, as after mkdir -p or a
+ * move, is picked up here, since no event is sent for it.
+ */
+static void watch_new_directory(WatchState *state, const gchar *dir_name)
+{
+	g_autofree gchar *dir_path =
+		g_build_filename(directory, dir_name, NULL);
+	g_autoptr(GFile) dir = NULL;
+	g_autoptr(GDir) contents = NULL;
+	const gchar *name = NULL;
+
+	// symlinks are not followed, as in scan_directory()
+	if (g_file_test(dir_path, G_FILE_TEST_IS_SYMLINK) ||
+	    !g_file_test(dir_path, G_FILE_TEST_IS_DIR) ||
+	    g_ptr_array_find_with_equal_func(state->dir_names, dir_name,
+					     g_str_equal, NULL))
+		return;
+
+	dir = g_file_resolve_relative_path(state->root, dir_name);
+	if (!monitor_directory(state, dir))
+		return;
+	g_ptr_array_add(state->dir_names, g_strdup(dir_name));
+	state->file_set_changed = TRUE;
+
+	contents = g_dir_open(dir_path, 0, NULL);
+	while (contents && (name = g_dir_read_name(contents)) != NULL) {
+		g_autofree gchar *relative_name =
+			g_build_filename(dir_name, name, NULL);
+
+		if (is_ui_file_name(name))
+			schedule_regeneration(state, relative_name);
+		else
+			watch_new_directory(state, relative_name);
+	}
+}
+
+static void on_directory_changed(GFileMonitor *monitor, GFile *file,
+				 GFile *other_file, GFileMonitorEvent event,
+				 gpointer user_data)
+{
+	WatchState *state = (WatchState *)user_data;
+	g_autofree gchar *file_name =
+		g_file_get_relative_path(state->root, file);
+	g_autofree gchar *other_file_name =
+		other_file ? g_file_get_relative_path(state->root, other_file) :
+			     NULL;
+
+	if (file_name == NULL)
+		return;
+
+	switch (event) {
+	case G_FILE_MONITOR_EVENT_CHANGED:
+	case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+	case G_FILE_MONITOR_EVENT_CREATED:
+	case G_FILE_MONITOR_EVENT_MOVED_IN:
+		if (is_ui_file_name(file_name))
+			schedule_regeneration(state, file_name);
+		else if (recursive)
+			watch_new_directory(state, file_name);
+		break;
+	case G_FILE_MONITOR_EVENT_DELETED:
+	case G_FILE_MONITOR_EVENT_MOVED_OUT:
+		if (is_ui_file_name(file_name))
+			forget_file(state, file_name);
+		break;
+	case G_FILE_MONITOR_EVENT_RENAMED:
+		// editors commonly save to a temporary file and rename it
+		if (is_ui_file_name(file_name))
+			forget_file(state, file_name);
+		if (other_file_name && is_ui_file_name(other_file_name))
+			schedule_regeneration(state, other_file_name);
+		else if (other_file_name && recursive)
+			watch_new_directory(state, other_file_name);
+		break;
+	default:
+		break;
+	}
+}
+
+static void schedule_regeneration(WatchState *state, const gchar *file_name)
+{
+	gpointer source_id = g_hash_table_lookup(state->pending_files,
+						 file_name);
+	PendingFile *pending_file = NULL;
+
+	if (source_id)
+		g_source_remove(GPOINTER_TO_UINT(source_id));
+
+	pending_file = g_new0(PendingFile, 1);
+	pending_file->state = state;
+	pending_file->file_name = g_strdup(file_name);
+	source_id = GUINT_TO_POINTER(g_timeout_add_full(
+		G_PRIORITY_DEFAULT, watch_delay, regenerate_pending_file,
+		pending_file, (GDestroyNotify)destroy_pending_file));
+	g_hash_table_replace(state->pending_files, g_strdup(file_name),
+			     source_id);
+}
+
+static gboolean regenerate_pending_file(gpointer user_data)
+{
+	PendingFile *pending_file = (PendingFile *)user_data;
+	WatchState *state = pending_file->state;
+	const gchar *file_name = pending_file->file_name;
+	g_autofree gchar *file_path =
+		g_build_filename(directory, file_name, NULL);
+
+	if (!g_file_test(file_path, G_FILE_TEST_IS_REGULAR)) {
+		g_hash_table_remove(state->pending_files, file_name);
+		return G_SOURCE_REMOVE;
+	}
+
+	if (!g_ptr_array_find_with_equal_func(state->file_names, file_name,
+					      g_str_equal, NULL)) {
+		g_ptr_array_add(state->file_names, g_strdup(file_name));
+		state->file_set_changed = TRUE;
+	}
+
+	read_and_parse_xml_file(file_name);
+	save_cache_manifest(state->file_names);
+	if (depfile && state->file_set_changed)
+		generate_depfile(state->file_names, state->dir_names);
+	state->file_set_changed = FALSE;
+
+	g_hash_table_remove(state->pending_files, file_name);
+	return G_SOURCE_REMOVE;
+}
+
+static void destroy_pending_file(PendingFile *pending_file)
+{
+	g_free(pending_file->file_name);
+	g_free(pending_file);
+}
+
+static void forget_file(WatchState *state, const gchar *file_name)
+{
+	guint index = 0;
+
+	if (!g_ptr_array_find_with_equal_func(state->file_names, file_name,
+					      g_str_equal, &index))
+		return;
+
+	g_ptr_array_remove_index(state->file_names, index);
+	unindex_file_symbols(file_name);
+	cache_entry_remove(file_name);
+	save_cache_manifest(state->file_names);
+	if (depfile)
+		generate_depfile(state->file_names, state->dir_names);
+}
+
+static gboolean quit_main_loop(gpointer user_data)
+{
+	g_main_loop_quit((GMainLoop *)user_data);
+	return G_SOURCE_CONTINUE;
+}
+
+static void read_and_parse_xml_file(const gchar *file_name)
+{
+	FileStats file_stats = { 0 };
+	const gint64 start_time = g_get_monotonic_time();
+
+	parse_xml_file(file_name, &file_stats);
+	enter_alloc_phase(ALLOC_PHASE_OTHER);
+	if (!collect_stats)
+		return;
+
+	file_stats.file_name = (gchar *)file_name;
+	file_stats.total_usec = g_get_monotonic_time() - start_time;
+	record_file_stats(&file_stats);
+}
+
+static void parse_xml_file(const gchar *file_name, FileStats *file_stats)
+{
+	ViewBindingState *state = NULL;
+	g_autoptr(GMarkupParseContext) context = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autofree gchar *file_path =
+		g_build_filename(directory, file_name, NULL);
+	g_autoptr(GBytes) xml_bytes = NULL;
+	g_autofree gchar *checksum = NULL;
+	const gchar *xml_content = NULL;
+	g_auto(GStrv) group_structs = NULL;
+	gsize file_size = 0;
+	guint64 input_size = 0;
+	guint64 input_mtime = 0;
+	gint64 phase_start = 0;
+
+	// unchanged files still claim their names
+	if (!index_file_symbols(file_name)) {
+		cache_entry_remove(file_name);
+		return;
+	}
+
+	// unchanged size and mtime: skip without reading the file
+	if (cache_manifest &&
+	    query_input_file(file_path, &input_size, &input_mtime) &&
+	    cache_entry_is_fresh(file_name, input_size, input_mtime, NULL)) {
+		file_stats->unchanged = TRUE;
+		index_cached_structs(file_name);
+		return;
+	}
+
+	if (read_mode != READ_MODE_STREAM) {
+		phase_start = g_get_monotonic_time();
+		enter_alloc_phase(ALLOC_PHASE_READ);
+		xml_bytes = read_input_file(file_path, &error);
+		enter_alloc_phase(ALLOC_PHASE_OTHER);
+		file_stats->read_usec = g_get_monotonic_time() - phase_start;
+		if (error) {
+			g_printerr("Error reading file %s: %s\n", file_path,
+				   error->message);
+			g_error_free(error);
+			error = NULL;
+			cache_entry_remove(file_name);
+			return;
+		}
+		xml_content = g_bytes_get_data(xml_bytes, &file_size);
+		if (xml_content == NULL)
+			xml_content = "";
+		file_stats->bytes_in = file_size;
+
+		// touched but identical content: refresh the entry, skip
+		// parsing
+		if (cache_manifest) {
+			checksum = g_compute_checksum_for_data(
+				G_CHECKSUM_SHA256, (const guchar *)xml_content,
+				file_size);
+			if (cache_entry_is_fresh(file_name, file_size, 0,
+						 checksum)) {
+				cache_entry_update(file_name, file_size,
+						   input_mtime, checksum);
+				file_stats->unchanged = TRUE;
+				index_cached_structs(file_name);
+				return;
+			}
+		}
+	}
+
+	// the strings of the previous file are dropped here, not after it
+	enter_alloc_phase(ALLOC_PHASE_PARSE);
+	state = get_view_binding_state();
+	reset_view_binding_state(state);
+	state->file_name = file_name;
+	if (minify_ui && state->minified_buffer == NULL) {
+		state->minified_buffer = g_string_new(NULL);
+		state->pending_space = g_string_new(NULL);
+	}
+
+	// GMarkupParseContext cannot be reset, so it is still made per file
+	if (engine == PARSE_ENGINE_MARKUP)
+		context = g_markup_parse_context_new(
+			minify_ui ? &minify_xml_parser : &xml_parser, 0, state,
+			NULL);
+
+	phase_start = g_get_monotonic_time();
+	if (read_mode == READ_MODE_STREAM) {
+		gboolean parsed = parse_input_stream(
+			context, file_path, &file_size,
+			cache_manifest ? &checksum : NULL, &error);
+		enter_alloc_phase(ALLOC_PHASE_OTHER);
+		file_stats->parse_usec = g_get_monotonic_time() - phase_start;
+		file_stats->bytes_in = file_size;
+		if (!parsed) {
+			if (error && error->domain != G_MARKUP_ERROR)
+				g_printerr("Error reading file %s: %s\n",
+					   file_path, error->message);
+			else
+				g_printerr("Error parsing XML file %s: %s\n",
+					   file_path,
+					   error ? error->message :
+						   "Unknown error");
+			cache_entry_remove(file_name);
+			return;
+		}
+
+		// the content is only known once it has been parsed, but an
+		// unchanged file still needs no new header
+		if (cache_entry_is_fresh(file_name, file_size, 0, checksum)) {
+			cache_entry_update(file_name, file_size, input_mtime,
+					   checksum);
+			file_stats->unchanged = TRUE;
+			index_cached_structs(file_name);
+			return;
+		}
+	} else if (!parse_input_buffer(context, state, xml_content, file_size,
+				       &error)) {
+		g_printerr("Error parsing XML file %s: %s\n", file_path,
+			   error ? error->message : "Unknown error");
+		if (error) {
+			g_error_free(error);
+			error = NULL;
+		}
+		cache_entry_remove(file_name);
+		return;
+	}
+
+	enter_alloc_phase(ALLOC_PHASE_OTHER);
+	if (read_mode != READ_MODE_STREAM)
+		file_stats->parse_usec = g_get_monotonic_time() - phase_start;
+	file_stats->objects = state->parsers[PARSER_OBJECT].element_count;
+	file_stats->signals = state->parsers[PARSER_SIGNAL].element_count;
+	if (!check_object_ids(state)) {
+		g_atomic_int_set(&symbol_conflicts, 1);
+		cache_entry_remove(file_name);
+		return;
+	}
+	// annotations anywhere in the file apply to all of its objects
+	filter_object_bindings(state);
+	group_structs = index_group_structs(state, file_name);
+
+	enter_alloc_phase(ALLOC_PHASE_GENERATE);
+	if (generate_code(state, file_name, file_stats)) {
+		enter_alloc_phase(ALLOC_PHASE_OTHER);
+		cache_entry_update(file_name, file_size, input_mtime, checksum);
+		cache_entry_set_structs(file_name, group_structs);
+	} else {
+		enter_alloc_phase(ALLOC_PHASE_OTHER);
+		cache_entry_remove(file_name);
+	}
+}
+
+/*
+ * Maps the file so the parser reads the page cache directly, and falls back
+ * to a heap copy for files that cannot be mapped (pipes, some virtual file
+ * systems) or when --read-mode=read is given.
+ */
+static GBytes *read_input_file(const gchar *file_path, GError **error)
+{
+	gchar *content = NULL;
+	gsize size = 0;
+
+	if (use_stdio)
+		return read_standard_input(error);
+
+	if (read_mode == READ_MODE_MMAP) {
+		g_autoptr(GMappedFile) mapped_file =
+			g_mapped_file_new(file_path, FALSE, NULL);
+		if (mapped_file)
+			return g_mapped_file_get_bytes(mapped_file);
+	}
+
+	if (!g_file_get_contents(file_path, &content, &size, error))
+		return NULL;
+	return g_bytes_new_take(content, size);
+}
+
+static GBytes *read_standard_input(GError **error)
+{
+	g_autoptr(GByteArray) content = g_byte_array_new();
+	guint8 buffer[64 * 1024];
+	gsize length = 0;
+
+	while ((length = fread(buffer, 1, sizeof(buffer), stdin)) > 0)
+		g_byte_array_append(content, buffer, length);
+	if (ferror(stdin)) {
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+			    "%s", g_strerror(errno));
+		return NULL;
+	}
+
+	return g_byte_array_free_to_bytes(g_steal_pointer(&content));
+}
+
+static gboolean parse_input_buffer(GMarkupParseContext *context,
+				   ViewBindingState *state, const gchar *text,
+				   gsize size, GError **error)
+{
+	if (engine == PARSE_ENGINE_FAST)
+		return fast_scan_parse(state, text, size, error);
+	return g_markup_parse_context_parse(context, text, size, error);
+}
+
+/*
+ * --engine fast: jumps from '<' to '<' with memchr(), which libc
+ * vectorizes, and skips comments, CDATA, processing instructions, end tags
+ * and every element no parser is registered for without looking at their
+ * content. Only the attributes of registered elements are unescaped,
+ * normalized and handed to start(). Unlike GMarkup this does not validate
+ * the document. Malformed input that still yields tags is accepted.
+ */
+static gboolean fast_scan_parse(ViewBindingState *state, const gchar *text,
+				gsize size, GError **error)
+{
+	const gchar *p = text;
+	const gchar *end = text + size;
+	g_autoptr(GString) scratch = g_string_new(NULL);
+	g_autoptr(GArray) offsets = g_array_new(FALSE, FALSE, sizeof(gsize));
+
+	while ((p = memchr(p, '<', end - p)) != NULL) {
+		const gsize left = end - p;
+
+		if (left >= 4 && memcmp(p, "<!--", 4) == 0) {
+			const gchar *comment = p;
+			p = fast_scan_skip_past(p + 4, end, "-->");
+			if (p)
+				handle_annotation(state, comment, p - comment);
+		} else if (left >= 9 && memcmp(p, "<![CDATA[", 9) == 0)
+			p = fast_scan_skip_past(p + 9, end, "]]>");
+		else if (left >= 2 && p[1] == '?')
+			p = fast_scan_skip_past(p + 2, end, "?>");
+		else if (left >= 2 && p[1] == '/')
+			p = fast_scan_end_element(state, p + 2, end);
+		else if (left >= 2 && p[1] == '!')
+			p = fast_scan_skip_tag(p + 2, end);
+		else
+			p = fast_scan_element(state, p + 1, end, scratch,
+					      offsets, error);
+
+		if (p == NULL) {
+			if (error && *error == NULL)
+				g_set_error_literal(
+					error, G_MARKUP_ERROR,
+					G_MARKUP_ERROR_PARSE,
+					"Document ended unexpectedly inside a tag or comment");
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/*
+ * Returns the position after the tag starting at p, just after its '<'.
+ * Names and unescaped values go to scratch as NUL terminated strings,
+ * offsets remembers where they start until scratch stops growing.
+ */
+static const gchar *fast_scan_element(ViewBindingState *state,
+				      const gchar *p, const gchar *end,
+				      GString *scratch, GArray *offsets,
+				      GError **error)
+{
+	const gchar *name = p;
+	gchar element_name[64];
+	gsize name_length = 0;
+	gboolean empty = FALSE;
+
+	while (p < end && !g_ascii_isspace(*p) && *p != '>' && *p != '/')
+		p++;
+	name_length = p - name;
+	if (name_length == 0 || name_length >= sizeof(element_name))
+		return fast_scan_skip_tag(p, end);
+
+	memcpy(element_name, name, name_length);
+	element_name[name_length] = '\0';
+	if (lookup_parser(state, element_name) == NULL)
+		return fast_scan_skip_tag(p, end);
+
+	g_string_truncate(scratch, 0);
+	g_array_set_size(offsets, 0);
+	for (;;) {
+		const gchar *attribute_name = NULL;
+		gsize attribute_name_length = 0;
+		const gchar *value_end = NULL;
+		gchar quote = '\0';
+		gsize offset = 0;
+
+		while (p < end && g_ascii_isspace(*p))
+			p++;
+		if (p == end)
+			return NULL;
+		if (*p == '>') {
+			p++;
+			break;
+		}
+		if (*p == '/') {
+			if (p + 1 == end)
+				return NULL;
+			p += 2;
+			empty = TRUE;
+			break;
+		}
+
+		attribute_name = p;
+		while (p < end && !g_ascii_isspace(*p) && *p != '=' &&
+		       *p != '>' && *p != '/')
+			p++;
+		attribute_name_length = p - attribute_name;
+		offset = scratch->len;
+		g_string_append_len(scratch, attribute_name,
+				    attribute_name_length);
+		g_string_append_c(scratch, '\0');
+		g_array_append_val(offsets, offset);
+
+		while (p < end && g_ascii_isspace(*p))
+			p++;
+		if (p < end && *p == '=')
+			p++;
+		while (p < end && g_ascii_isspace(*p))
+			p++;
+		if (p == end)
+			return NULL;
+		if (*p != '"' && *p != '\'') {
+			g_set_error(error, G_MARKUP_ERROR, G_MARKUP_ERROR_PARSE,
+				    "Attribute '%.*s' of element '%s' has no quoted value",
+				    (int)attribute_name_length, attribute_name,
+				    element_name);
+			return NULL;
+		}
+		quote = *p++;
+		value_end = memchr(p, quote, end - p);
+		if (value_end == NULL)
+			return NULL;
+
+		offset = scratch->len;
+		append_unescaped(scratch, p, value_end);
+		g_string_append_c(scratch, '\0');
+		g_array_append_val(offsets, offset);
+		p = value_end + 1;
+	}
+
+	// scratch no longer moves, turn the offsets into string vectors
+	const guint n_attributes = offsets->len / 2;
+	g_autofree const gchar **attribute_names =
+		g_new(const gchar *, n_attributes + 1);
+	g_autofree const gchar **attribute_values =
+		g_new(const gchar *, n_attributes + 1);
+	for (guint i = 0; i < n_attributes; i++) {
+		attribute_names[i] =
+			scratch->str + g_array_index(offsets, gsize, i * 2);
+		attribute_values[i] =
+			scratch->str + g_array_index(offsets, gsize, i * 2 + 1);
+	}
+	attribute_names[n_attributes] = NULL;
+	attribute_values[n_attributes] = NULL;
+
+	start(NULL, element_name, attribute_names, attribute_values, state,
+	      error);
+	// <object/> ends where it starts
+	if (empty)
+		end_element(NULL, element_name, state, error);
+	return p;
+}
+
+// End tags are only looked at far enough to find those of registered elements
+static const gchar *fast_scan_end_element(ViewBindingState *state,
+					  const gchar *p, const gchar *end)
+{
+	const gchar *name = p;
+	gchar element_name[64];
+	gsize name_length = 0;
+
+	while (p < end && !g_ascii_isspace(*p) && *p != '>')
+		p++;
+	name_length = p - name;
+	if (name_length > 0 && name_length < sizeof(element_name)) {
+		memcpy(element_name, name, name_length);
+		element_name[name_length] = '\0';
+		end_element(NULL, element_name, state, NULL);
+	}
+	return fast_scan_skip_tag(p, end);
+}
+
+// quoted values may contain '>'
+static const gchar *fast_scan_skip_tag(const gchar *p, const gchar *end)
+{
+	while (p < end) {
+		if (*p == '"' || *p == '\'') {
+			p = memchr(p + 1, *p, end - p - 1);
+			if (p == NULL)
+				return NULL;
+		} else if (*p == '>') {
+			return p + 1;
+		}
+		p++;
+	}
+	return NULL;
+}
+
+static const gchar *fast_scan_skip_past(const gchar *p, const gchar *end,
+					const gchar *terminator)
+{
+	const gsize length = strlen(terminator);
+
+	while ((p = memchr(p, terminator[0], end - p)) != NULL) {
+		if ((gsize)(end - p) < length)
+			return NULL;
+		if (memcmp(p, terminator, length) == 0)
+			return p + length;
+		p++;
+	}
+	return NULL;
+}
+
+// the five predefined entities and character references, like GMarkup
+static void append_unescaped(GString *output_buffer, const gchar *p,
+			     const gchar *end)
+{
+	const gchar *amp = NULL;
+
+	while ((amp = memchr(p, '&', end - p)) != NULL) {
+		const gchar *semicolon = memchr(amp, ';', end - amp);
+		const gsize length = semicolon ? semicolon - amp - 1 : 0;
+		const gchar *entity = amp + 1;
+		gunichar c = 0;
+
+		append_normalized(output_buffer, p, amp);
+		p = amp + 1;
+		if (semicolon == NULL) {
+			g_string_append_c(output_buffer, '&');
+			continue;
+		}
+
+		if (length == 3 && memcmp(entity, "amp", 3) == 0)
+			c = '&';
+		else if (length == 2 && memcmp(entity, "lt", 2) == 0)
+			c = '<';
+		else if (length == 2 && memcmp(entity, "gt", 2) == 0)
+			c = '>';
+		else if (length == 4 && memcmp(entity, "quot", 4) == 0)
+			c = '"';
+		else if (length == 4 && memcmp(entity, "apos", 4) == 0)
+			c = '\'';
+		else if (length >= 2 && entity[0] == '#') {
+			// all digits up to the ';' and in range, as GMarkup
+			// requires
+			const gboolean hex = entity[1] == 'x';
+			const gchar *digits = entity + (hex ? 2 : 1);
+			gchar *digits_end = NULL;
+			const guint64 value = g_ascii_strtoull(
+				digits, &digits_end, hex ? 16 : 10);
+
+			if (digits_end != digits && digits_end == semicolon &&
+			    value <= 0x10FFFF)
+				c = (gunichar)value;
+		}
+
+		if (c == 0 || !g_unichar_validate(c)) {
+			g_string_append_c(output_buffer, '&');
+			continue;
+		}
+		g_string_append_unichar(output_buffer, c);
+		p = semicolon + 1;
+	}
+	append_normalized(output_buffer, p, end);
+}
+
+/*
+ * Literal tabs, newlines and carriage returns of an attribute value become
+ * spaces, a CRLF pair a single one, as GMarkup does. Character references
+ * to them are kept.
+ */
+static void append_normalized(GString *output_buffer, const gchar *p,
+			      const gchar *end)
+{
+	const gchar *start = p;
+
+	for (; p < end; p++) {
+		if (*p != '\t' && *p != '\n' && *p != '\r')
+			continue;
+		g_string_append_len(output_buffer, start, p - start);
+		g_string_append_c(output_buffer, ' ');
+		if (*p == '\r' && p + 1 < end && p[1] == '\n')
+			p++;
+		start = p + 1;
+	}
+	g_string_append_len(output_buffer, start, end - start);
+}
+
+/*
+ * Feeds the file to the parser chunk_size bytes at a time, so peak memory
+ * does not depend on the size of the input. The checksum for the cache is
+ * computed over the same chunks.
+ */
+static gboolean parse_input_stream(GMarkupParseContext *context,
+				   const gchar *file_path, gsize *size,
+				   gchar **checksum, GError **error)
+{
+	g_autoptr(GFile) file = g_file_new_for_path(file_path);
+	g_autoptr(GFileInputStream) stream = NULL;
+	g_autoptr(GChecksum) content_checksum = NULL;
+	g_autofree gchar *chunk = NULL;
+	gssize read_size = 0;
+
+	*size = 0;
+	stream = g_file_read(file, NULL, error);
+	if (stream == NULL)
+		return FALSE;
+
+	if (checksum)
+		content_checksum = g_checksum_new(G_CHECKSUM_SHA256);
+
+	chunk = g_malloc(chunk_size);
+	while ((read_size = g_input_stream_read(G_INPUT_STREAM(stream), chunk,
+						chunk_size, NULL, error)) > 0) {
+		if (content_checksum)
+			g_checksum_update(content_checksum,
+					  (const guchar *)chunk, read_size);
+		if (!g_markup_parse_context_parse(context, chunk, read_size,
+						  error))
+			return FALSE;
+		*size += read_size;
+	}
+	if (read_size < 0)
+		return FALSE;
+
+	if (checksum)
+		*checksum = g_strdup(g_checksum_get_string(content_checksum));
+	return TRUE;
+}
+
+static void start(GMarkupParseContext *context, const gchar *element_name,
+		  const gchar **attribute_names, const gchar **attribute_values,
+		  gpointer user_data, GError **error)
+{
+	ViewBindingState *state = (ViewBindingState *)user_data;
+	ViewBindingParser *parser = lookup_parser(state, element_name);
+	if (parser)
+		parser->element_count++;
+	if (parser && parser->handle_attribute) {
+		const gboolean had_user_data = parser->user_data != NULL;
+		const AllocPhase phase =
+			enter_alloc_phase(ALLOC_PHASE_ATTRIBUTES);
+
+		parser->handle_attribute(state->arena, element_name,
+					 attribute_names, attribute_values,
+					 &parser->user_data);
+		enter_alloc_phase(phase);
+		if (alloc_stats && !had_user_data && parser->user_data)
+			g_atomic_int_inc(&parser_data_created);
+	}
+}
+
+static void end_element(GMarkupParseContext *context,
+			const gchar *element_name, gpointer user_data,
+			GError **error)
+{
+	ViewBindingState *state = (ViewBindingState *)user_data;
+	ViewBindingParser *parser = lookup_parser(state, element_name);
+	if (parser && parser->handle_end)
+		parser->handle_end(element_name, &parser->user_data);
+}
+
+static void passthrough(GMarkupParseContext *context, const gchar *text,
+			gsize text_len, gpointer user_data, GError **error)
+{
+	handle_annotation((ViewBindingState *)user_data, text, text_len);
+}
+
+/*
+ * --minify-ui rebuilds the document without comments, the XML declaration
+ * and other processing instructions, and the whitespace between tags.
+ * Attributes known to only restate GtkBuilder's defaults are left out.
+ * Whitespace is kept where it is the whole content of an element, as in a
+ * label of one space.
+ */
+static void minify_start(GMarkupParseContext *context,
+			 const gchar *element_name,
+			 const gchar **attribute_names,
+			 const gchar **attribute_values, gpointer user_data,
+			 GError **error)
+{
+	ViewBindingState *state = (ViewBindingState *)user_data;
+	GString *output_buffer = state->minified_buffer;
+	gboolean translatable = FALSE;
+
+	start(context, element_name, attribute_names, attribute_values,
+	      user_data, error);
+
+	close_start_tag(state);
+	g_string_truncate(state->pending_space, 0);
+	g_string_append_c(output_buffer, '<');
+	g_string_append(output_buffer, element_name);
+
+	for (guint i = 0; attribute_names[i]; i++) {
+		if (g_strcmp0(attribute_names[i], "translatable") == 0)
+			translatable = !is_default_attribute(
+				element_name, attribute_names[i],
+				attribute_values[i], TRUE);
+	}
+	for (guint i = 0; attribute_names[i]; i++) {
+		if (is_default_attribute(element_name, attribute_names[i],
+					 attribute_values[i], translatable))
+			continue;
+		g_string_append_c(output_buffer, ' ');
+		g_string_append(output_buffer, attribute_names[i]);
+		g_string_append(output_buffer, "=\"");
+		append_escaped(output_buffer, attribute_values[i],
+			       strlen(attribute_values[i]), TRUE);
+		g_string_append_c(output_buffer, '"');
+	}
+	state->tag_open = TRUE;
+}
+
+static void minify_end(GMarkupParseContext *context, const gchar *element_name,
+		       gpointer user_data, GError **error)
+{
+	ViewBindingState *state = (ViewBindingState *)user_data;
+	GString *output_buffer = state->minified_buffer;
+
+	end_element(context, element_name, user_data, error);
+
+	// whitespace only followed the start tag: it is the content
+	if (state->tag_open && state->pending_space->len > 0) {
+		close_start_tag(state);
+		append_escaped(output_buffer, state->pending_space->str,
+			       state->pending_space->len, FALSE);
+	}
+	g_string_truncate(state->pending_space, 0);
+
+	if (state->tag_open) {
+		g_string_append(output_buffer, "/>");
+		state->tag_open = FALSE;
+		return;
+	}
+	g_string_append(output_buffer, "</");
+	g_string_append(output_buffer, element_name);
+	g_string_append_c(output_buffer, '>');
+}
+
+static void minify_text(GMarkupParseContext *context, const gchar *text,
+			gsize text_len, gpointer user_data, GError **error)
+{
+	ViewBindingState *state = (ViewBindingState *)user_data;
+
+	for (gsize i = 0; i < text_len; i++) {
+		if (!g_ascii_isspace(text[i])) {
+			close_start_tag(state);
+			append_escaped(state->minified_buffer,
+				       state->pending_space->str,
+				       state->pending_space->len, FALSE);
+			g_string_truncate(state->pending_space, 0);
+			append_escaped(state->minified_buffer, text, text_len,
+				       FALSE);
+			return;
+		}
+	}
+	g_string_append_len(state->pending_space, text, text_len);
+}
+
+// GMarkup hands CDATA sections over verbatim, unlike text
+static void minify_passthrough(GMarkupParseContext *context,
+			       const gchar *text, gsize text_len,
+			       gpointer user_data, GError **error)
+{
+	ViewBindingState *state = (ViewBindingState *)user_data;
+
+	passthrough(context, text, text_len, user_data, error);
+	if (text_len < 9 || memcmp(text, "<![CDATA[", 9) != 0)
+		return;
+
+	close_start_tag(state);
+	append_escaped(state->minified_buffer, state->pending_space->str,
+		       state->pending_space->len, FALSE);
+	g_string_truncate(state->pending_space, 0);
+	g_string_append_len(state->minified_buffer, text, text_len);
+}
+
+/*
+ * Only attributes whose absence GtkBuilder reads the same way. Property
+ * values are always kept: the class, or a subclass init function, decides
+ * what their default is.
+ */
+static gboolean is_default_attribute(const gchar *element_name,
+				     const gchar *attribute_name,
+				     const gchar *attribute_value,
+				     gboolean translatable)
+{
+	static const gchar *const false_values[] = { "no", "false", "n", "f",
+						     "0", NULL };
+
+	if (g_strcmp0(element_name, "property") != 0)
+		return FALSE;
+
+	if (g_strcmp0(attribute_name, "translatable") == 0) {
+		for (guint i = 0; false_values[i]; i++) {
+			if (g_ascii_strcasecmp(attribute_value,
+					       false_values[i]) == 0)
+				return TRUE;
+		}
+		return FALSE;
+	}
+	// translator comments are read by xgettext, not at runtime
+	if (g_strcmp0(attribute_name, "comments") == 0)
+		return TRUE;
+	// a context only disambiguates a translated string
+	if (g_strcmp0(attribute_name, "context") == 0)
+		return !translatable;
+	return FALSE;
+}
+
+static void close_start_tag(ViewBindingState *state)
+{
+	if (state->tag_open) {
+		g_string_append_c(state->minified_buffer, '>');
+		state->tag_open = FALSE;
+	}
+}
+
+// Line breaks and tabs in attributes are escaped so they survive reparsing
+static void append_escaped(GString *output_buffer, const gchar *text,
+			   gsize length, gboolean attribute)
+{
+	const gchar *end = text + length;
+
+	for (const gchar *p = text; p < end; p++) {
+		switch (*p) {
+		case '&':
+			g_string_append(output_buffer, "&amp;");
+			break;
+		case '<':
+			g_string_append(output_buffer, "&lt;");
+			break;
+		case '>':
+			g_string_append(output_buffer, "&gt;");
+			break;
+		case '"':
+			if (attribute)
+				g_string_append(output_buffer, "&quot;");
+			else
+				g_string_append_c(output_buffer, *p);
+			break;
+		case '\t':
+		case '\n':
+		case '\r':
+			if (attribute)
+				g_string_append_printf(output_buffer, "&#%d;",
+						       *p);
+			else
+				g_string_append_c(output_buffer, *p);
+			break;
+		default:
+			g_string_append_c(output_buffer, *p);
+			break;
+		}
+	}
+}
+
+/*
+ * <!-- viewbinding:include PATTERN... --> and
+ * <!-- viewbinding:exclude PATTERN... --> add file level binding rules,
+ * other comments are ignored.
+ */
+static void handle_annotation(ViewBindingState *state, const gchar *text,
+			      gsize length)
+{
+	static const gchar prefix[] = "viewbinding:";
+	const gchar *p = text + 4;
+	const gchar *end = text + length - 3;
+	g_autofree gchar *annotation = NULL;
+	g_auto(GStrv) words = NULL;
+	GPtrArray *specs = NULL;
+
+	if (length < 7 || memcmp(text, "<!--", 4) != 0 ||
+	    memcmp(end, "-->", 3) != 0)
+		return;
+	while (p < end && g_ascii_isspace(*p))
+		p++;
+	if ((gsize)(end - p) < strlen(prefix) ||
+	    memcmp(p, prefix, strlen(prefix)) != 0)
+		return;
+
+	annotation = g_strndup(p + strlen(prefix), end - p - strlen(prefix));
+	words = g_strsplit_set(g_strstrip(annotation), " \t\r\n", -1);
+	if (g_strcmp0(words[0], "include") == 0) {
+		specs = state->include_specs;
+	} else if (g_strcmp0(words[0], "exclude") == 0) {
+		specs = state->exclude_specs;
+	} else {
+		g_printerr("Warning: %s: unknown annotation viewbinding:%s\n",
+			   state->file_name, words[0] ? words[0] : "");
+		return;
+	}
+
+	for (gchar **word = words + 1; *word; word++) {
+		if (**word != '\0')
+			g_ptr_array_add(specs, g_pattern_spec_new(*word));
+	}
+}
+
+// Drops the ids the include and exclude rules do not bind, keeping the order
+static void filter_object_bindings(ViewBindingState *state)
+{
+	ObjectBindings *object_bindings =
+		state->parsers[PARSER_OBJECT].user_data;
+	GArray *class_ids = NULL;
+	guint kept = 0;
+
+	if (object_bindings == NULL ||
+	    (bind_include_specs->len == 0 && bind_exclude_specs->len == 0 &&
+	     state->include_specs->len == 0 && state->exclude_specs->len == 0))
+		return;
+
+	class_ids = object_bindings->class_ids;
+	for (guint i = 0; i < class_ids->len; i++) {
+		const ClassId *class_id = &g_array_index(class_ids, ClassId, i);
+
+		if (object_is_bound(state, class_id))
+			g_array_index(class_ids, ClassId, kept++) = *class_id;
+	}
+	g_array_set_size(class_ids, kept);
+}
+
+/*
+ * Two objects with one id, or ids differing only in '-' and '_', would give
+ * the binding struct two members of one name and fail the compiler. The
+ * same goes for the sub-structs of --struct-layout nested.
+ */
+static gboolean check_object_ids(ViewBindingState *state)
+{
+	ObjectBindings *object_bindings =
+		state->parsers[PARSER_OBJECT].user_data;
+	g_autoptr(GHashTable) group_types = NULL;
+	GArray *class_ids = NULL;
+	gboolean unique = TRUE;
+
+	if (object_bindings == NULL)
+		return TRUE;
+
+	// header and Header would both name a HeaderBinding sub-struct
+	if (struct_layout == STRUCT_LAYOUT_NESTED)
+		group_types = g_hash_table_new_full(g_str_hash, g_str_equal,
+						    g_free, NULL);
+
+	class_ids = object_bindings->class_ids;
+	for (guint i = 0; i < class_ids->len; i++) {
+		const ClassId *class_id = &g_array_index(class_ids, ClassId, i);
+		const gchar *other_id =
+			g_hash_table_lookup(state->fields, class_id->field);
+
+		if (other_id == NULL) {
+			g_hash_table_insert(state->fields,
+					    (gpointer)class_id->field,
+					    (gpointer)class_id->id);
+		} else if (strcmp(other_id, class_id->id) == 0) {
+			g_printerr("Error: %s: id '%s' is used twice.\n",
+				   state->file_name, class_id->id);
+			unique = FALSE;
+		} else {
+			g_printerr(
+				"Error: %s: ids '%s' and '%s' both become the field '%s'.\n",
+				state->file_name, other_id, class_id->id,
+				class_id->field);
+			unique = FALSE;
+		}
+
+		if (group_types && class_id->group == class_id->field) {
+			gchar *group_type = get_pascal_string(class_id->group);
+			const gchar *other_group =
+				g_hash_table_lookup(group_types, group_type);
+
+			if (other_group && other_group != class_id->group) {
+				g_printerr(
+					"Error: %s: ids '%s' and '%s' would both name a %s sub-struct.\n",
+					state->file_name, other_group,
+					class_id->id, group_type);
+				unique = FALSE;
+			}
+			g_hash_table_insert(group_types, group_type,
+					    (gpointer)class_id->group);
+		}
+	}
+	return unique;
+}
+
+/*
+ * Claims the names the file generates, before the cache is asked, since a
+ * rename can make an unchanged file collide. Another file taking the same
+ * header would overwrite it, and with --emit-source the registration
+ * functions would not link. The same struct or macros in two directories
+ * only clash where both headers are included, which is reported but
+ * allowed. The sub-structs follow in index_group_structs().
+ */
+static gboolean index_file_symbols(const gchar *file_name)
+{
+	g_autofree gchar *base_name = get_base_string(file_name);
+	g_autofree gchar *output_file_path =
+		get_output_file_path(file_name, "_viewbinding.h");
+	g_autofree gchar *pascal_name = get_pascal_string(base_name);
+	g_autofree gchar *struct_name =
+		g_strconcat(pascal_name, "Binding", NULL);
+	g_autofree gchar *prefix = NULL;
+	gboolean claimed = TRUE;
+
+	if (symbol_index == NULL)
+		return TRUE;
+
+	prefix = g_strconcat(base_name, "_view_binding", NULL);
+
+	// files with one prefix also share the struct, it is reported once
+	if (!index_symbol(output_file_path, file_name, "the header", TRUE))
+		claimed = FALSE;
+	else if (!index_symbol(prefix, file_name,
+			       emit_source ? "the function prefix" :
+					     "the macro prefix",
+			       emit_source))
+		claimed = !emit_source;
+	else
+		index_symbol(struct_name, file_name, "the binding struct",
+			     FALSE);
+	if (!claimed) {
+		g_atomic_int_set(&symbol_conflicts, 1);
+		unindex_file_symbols(file_name);
+	}
+	return claimed;
+}
+
+// Returns FALSE when another file has the symbol
+static gboolean index_symbol(const gchar *symbol, const gchar *file_name,
+			     const gchar *description, gboolean fatal)
+{
+	const gchar *owner = NULL;
+	gboolean claimed = TRUE;
+
+	g_mutex_lock(&symbol_lock);
+	owner = g_hash_table_lookup(symbol_index, symbol);
+	if (owner == NULL) {
+		g_hash_table_insert(symbol_index, g_strdup(symbol),
+				    g_strdup(file_name));
+	} else if (strcmp(owner, file_name) != 0) {
+		// named in order, whichever file came first
+		const gboolean owner_first = strcmp(owner, file_name) < 0;
+
+		g_printerr("%s: %s and %s both generate %s %s",
+			   fatal ? "Error" : "Warning",
+			   owner_first ? owner : file_name,
+			   owner_first ? file_name : owner, description,
+			   symbol);
+		if (fatal)
+			g_printerr(", %s is skipped.\n", file_name);
+		else
+			g_printerr(
+				", their headers cannot be included together.\n");
+		claimed = FALSE;
+	}
+	g_mutex_unlock(&symbol_lock);
+	return claimed;
+}
+
+static void unindex_file_symbols(const gchar *file_name)
+{
+	GHashTableIter iter;
+	gpointer owner = NULL;
+
+	if (symbol_index == NULL)
+		return;
+
+	g_mutex_lock(&symbol_lock);
+	g_hash_table_iter_init(&iter, symbol_index);
+	while (g_hash_table_iter_next(&iter, NULL, &owner)) {
+		if (strcmp(owner, file_name) == 0)
+			g_hash_table_iter_remove(&iter);
+	}
+	g_mutex_unlock(&symbol_lock);
+}
+
+/*
+ * The sub-structs of --struct-layout nested are named after the file and the
+ * group, so window.ui with a header group and window-header.ui both make a
+ * WindowHeaderBinding. They are only known once the file is parsed, so the
+ * cache entry keeps them for an unchanged file and the names the file had
+ * before are released here. Returns the names, NULL when there are none.
+ */
+static gchar **index_group_structs(ViewBindingState *state,
+				   const gchar *file_name)
+{
+	ObjectBindings *object_bindings =
+		state->parsers[PARSER_OBJECT].user_data;
+	g_auto(GStrv) cached_structs = NULL;
+	g_autofree gchar *base_name = NULL;
+	g_autofree gchar *binding_type = NULL;
+	GPtrArray *group_structs = NULL;
+	GArray *class_ids = NULL;
+
+	if (symbol_index != NULL) {
+		cached_structs = cache_entry_get_structs(file_name);
+		g_mutex_lock(&symbol_lock);
+		for (gchar **name = cached_structs; name && *name; name++) {
+			if (g_strcmp0(g_hash_table_lookup(symbol_index, *name),
+				      file_name) == 0)
+				g_hash_table_remove(symbol_index, *name);
+		}
+		g_mutex_unlock(&symbol_lock);
+	}
+
+	if (struct_layout != STRUCT_LAYOUT_NESTED || object_bindings == NULL)
+		return NULL;
+
+	base_name = get_base_string(file_name);
+	binding_type = get_pascal_string(base_name);
+	group_structs = g_ptr_array_new();
+	class_ids = object_bindings->class_ids;
+	// the runs generate_binding_structs() makes a sub-struct of
+	for (guint i = 0, next = 0; i < class_ids->len; i = next) {
+		const ClassId *first = &g_array_index(class_ids, ClassId, i);
+		g_autofree gchar *group_type = NULL;
+		gchar *name = NULL;
+
+		next = i + 1;
+		while (first->group && next < class_ids->len &&
+		       g_array_index(class_ids, ClassId, next).group ==
+			       first->group)
+			next++;
+		if (next - i == 1)
+			continue;
+
+		group_type = get_pascal_string(first->group);
+		name = g_strconcat(binding_type, group_type, "Binding", NULL);
+		if (symbol_index != NULL)
+			index_symbol(name, file_name, "the binding struct",
+				     FALSE);
+		g_ptr_array_add(group_structs, name);
+	}
+
+	if (group_structs->len == 0) {
+		g_ptr_array_free(group_structs, TRUE);
+		return NULL;
+	}
+	g_ptr_array_add(group_structs, NULL);
+	return (gchar **)g_ptr_array_free(group_structs, FALSE);
+}
+
+static void index_cached_structs(const gchar *file_name)
+{
+	g_auto(GStrv) group_structs = NULL;
+
+	if (symbol_index == NULL)
+		return;
+
+	group_structs = cache_entry_get_structs(file_name);
+	for (gchar **name = group_structs; name && *name; name++)
+		index_symbol(*name, file_name, "the binding struct", FALSE);
+}
+
+static gboolean object_is_bound(ViewBindingState *state,
+				const ClassId *class_id)
+{
+	const gboolean has_include = bind_include_specs->len > 0 ||
+				     state->include_specs->len > 0;
+
+	if (has_include &&
+	    !match_any_spec(bind_include_specs, class_id) &&
+	    !match_any_spec(state->include_specs, class_id))
+		return FALSE;
+
+	return !match_any_spec(bind_exclude_specs, class_id) &&
+	       !match_any_spec(state->exclude_specs, class_id);
+}
+
+static gboolean match_any_spec(GPtrArray *specs, const ClassId *class_id)
+{
+	for (guint i = 0; i < specs->len; i++) {
+		GPatternSpec *spec = g_ptr_array_index(specs, i);
+
+		if (g_pattern_spec_match_string(spec, class_id->id) ||
+		    g_pattern_spec_match_string(spec, class_id->class))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+static void destroy_view_binding_parser(ViewBindingParser *parser)
+{
+	if (parser->destroy_user_data && parser->user_data) {
+		parser->destroy_user_data(&parser->user_data);
+		if (alloc_stats)
+			g_atomic_int_inc(&parser_data_destroyed);
+	}
+	parser->user_data = NULL;
+}
+
+static ViewBindingState *get_view_binding_state(void)
+{
+	ViewBindingState *state = g_private_get(&view_binding_state);
+
+	if (state == NULL) {
+		state = g_new0(ViewBindingState, 1);
+		for (guint i = 0; i < N_PARSERS; i++)
+			state->parsers[i] = *parser_templates[i];
+		state->arena = g_string_chunk_new(4096);
+		state->include_specs = g_ptr_array_new_with_free_func(
+			(GDestroyNotify)g_pattern_spec_free);
+		state->exclude_specs = g_ptr_array_new_with_free_func(
+			(GDestroyNotify)g_pattern_spec_free);
+		state->fields = g_hash_table_new(g_str_hash, g_str_equal);
+		g_private_set(&view_binding_state, state);
+
+		g_mutex_lock(&parser_states_lock);
+		if (parser_states == NULL)
+			parser_states = g_ptr_array_new();
+		g_ptr_array_add(parser_states, state);
+		g_mutex_unlock(&parser_states_lock);
+	}
+
+	return state;
+}
+
+static void reset_view_binding_state(ViewBindingState *state)
+{
+	// back to the template, so no user_data or count outlives its file
+	for (guint i = 0; i < N_PARSERS; i++) {
+		destroy_view_binding_parser(&state->parsers[i]);
+		state->parsers[i] = *parser_templates[i];
+	}
+	g_string_chunk_clear(state->arena);
+	g_ptr_array_set_size(state->include_specs, 0);
+	g_ptr_array_set_size(state->exclude_specs, 0);
+	g_hash_table_remove_all(state->fields);
+	if (state->minified_buffer) {
+		g_string_truncate(state->minified_buffer, 0);
+		g_string_truncate(state->pending_space, 0);
+	}
+	state->tag_open = FALSE;
+}
+
+static void free_view_binding_state(ViewBindingState *state)
+{
+	// the teardown check sees the user_data either held or destroyed
+	g_mutex_lock(&parser_states_lock);
+	g_ptr_array_remove_fast(parser_states, state);
+	for (guint i = 0; i < N_PARSERS; i++)
+		destroy_view_binding_parser(&state->parsers[i]);
+	g_mutex_unlock(&parser_states_lock);
+	g_string_chunk_free(state->arena);
+	g_ptr_array_unref(state->include_specs);
+	g_ptr_array_unref(state->exclude_specs);
+	g_hash_table_unref(state->fields);
+	if (state->minified_buffer) {
+		g_string_free(state->minified_buffer, TRUE);
+		g_string_free(state->pending_space, TRUE);
+	}
+	g_free(state);
+}
+
+// Only the first character is switched on, the parsers share none
+static ViewBindingParser *lookup_parser(ViewBindingState *state,
+					const gchar *element_name)
+{
+	ViewBindingParser *parser = NULL;
+
+	switch (element_name[0]) {
+	case 'o':
+		parser = &state->parsers[PARSER_OBJECT];
+		break;
+	case 's':
+		parser = &state->parsers[PARSER_SIGNAL];
+		break;
+	default:
+		return NULL;
+	}
+
+	return strcmp(element_name, parser->element_name) == 0 ? parser : NULL;
+}
+
+// The entries only reference arena strings, so dropping the arrays is enough
+static void destroy_object_bindings(ObjectBindings **object_bindings)
+{
+	g_array_unref((*object_bindings)->class_ids);
+	g_ptr_array_unref((*object_bindings)->type_names);
+	g_free(*object_bindings);
+}
+
+static void destroy_signal_array(GArray **signal_array)
+{
+	g_array_unref(*signal_array);
+}
+
+static void handle_object_attribute(GStringChunk *arena,
+				    const gchar *element_name,
+				    const gchar **attribute_names,
+				    const gchar **attribute_values,
+				    gpointer user_data)
+{
+	ObjectBindings **object_bindings = (ObjectBindings **)user_data;
+	const gchar **cursor_name = attribute_names;
+	const gchar **cursor_value = attribute_values;
+
+	const gchar *class_value = NULL;
+	const gchar *id_value = NULL;
+	const gchar *type_name = NULL;
+	guint depth = 0;
+
+	while (cursor_name && *cursor_name) {
+		if (g_strcmp0(*cursor_name, "class") == 0) {
+			class_value = *cursor_value;
+		} else if (g_strcmp0(*cursor_name, "id") == 0) {
+			id_value = *cursor_value;
+		}
+		cursor_name++;
+		cursor_value++;
+	}
+
+	if (*object_bindings == NULL) {
+		*object_bindings = g_new0(ObjectBindings, 1);
+		(*object_bindings)->class_ids =
+			g_array_new(FALSE, FALSE, sizeof(ClassId));
+		(*object_bindings)->type_names = g_ptr_array_new();
+	}
+
+	// every object nests, handle_object_end() does not see the class
+	depth = (*object_bindings)->depth++;
+	if (depth == 0)
+		(*object_bindings)->group = NULL;
+	if (class_value == NULL)
+		return;
+
+	type_name = g_intern_string(class_value);
+	// interned, comparing pointers is enough
+	if (!g_ptr_array_find((*object_bindings)->type_names, type_name, NULL))
+		g_ptr_array_add((*object_bindings)->type_names,
+				(gpointer)type_name);
+
+	if (id_value) {
+		ClassId class_id = {
+			.class = type_name,
+			.id = g_string_chunk_insert(arena, id_value),
+		};
+		class_id.field = arena_insert_identifier(arena, class_id.id);
+		if (depth == 0)
+			(*object_bindings)->group = class_id.field;
+		class_id.group = (*object_bindings)->group;
+		g_array_append_val((*object_bindings)->class_ids, class_id);
+	}
+}
+
+static void handle_object_end(const gchar *element_name, gpointer user_data)
+{
+	ObjectBindings **object_bindings = (ObjectBindings **)user_data;
+
+	if (*object_bindings && (*object_bindings)->depth > 0)
+		(*object_bindings)->depth--;
+}
+
+static void handle_signal_attribute(GStringChunk *arena,
+				    const gchar *element_name,
+				    const gchar **attribute_names,
+				    const gchar **attribute_values,
+				    gpointer user_data)
+{
+	GArray **signal_array = (GArray **)user_data;
+	const gchar **cursor_name = attribute_names;
+	const gchar **cursor_value = attribute_values;
+
+	const gchar *signal_value = NULL;
+
+	while (cursor_name && *cursor_name) {
+		if (g_strcmp0(*cursor_name, "handler") == 0) {
+			signal_value = *cursor_value;
+			break;
+		}
+		cursor_name++;
+		cursor_value++;
+	}
+
+	if (signal_value) {
+		SignalHandler signal = {
+			.handler = g_intern_string(signal_value),
+		};
+		signal.symbol = arena_insert_identifier(arena, signal.handler);
+		if (*signal_array == NULL) {
+			*signal_array = g_array_new(FALSE, FALSE,
+						    sizeof(SignalHandler));
+		}
+		g_array_append_val(*signal_array, signal);
+	}
+}
+
+static gboolean generate_code(ViewBindingState *state, const gchar *file_name,
+			      FileStats *file_stats)
+{
+	const gint64 start_time = g_get_monotonic_time();
+	g_autofree gchar *base_name = get_base_string(file_name);
+	g_autofree gchar *guard_name = get_guard_string(file_name);
+	g_autofree gchar *common_header_include =
+		get_common_header_include(file_name);
+	g_autofree gchar *output_file_path =
+		get_output_file_path(file_name, "_viewbinding.h");
+	g_autofree gchar *output_dir_path =
+		g_path_get_dirname(output_file_path);
+	g_autofree gchar *source_file_path = NULL;
+	g_autofree gchar *minified_file_path = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GString) output_buffer = g_string_new(NULL);
+	g_autoptr(GString) source_buffer = NULL;
+	ViewBindingOutput output = {
+		.output_buffer = output_buffer,
+		.base_name = base_name,
+	};
+	OutputWriter header_writer;
+	OutputWriter source_writer;
+	OutputWriter minified_writer;
+	gboolean written = TRUE;
+	gint64 write_usec = 0;
+
+	if (emit_source) {
+		g_autofree gchar *header_name =
+			g_path_get_basename(output_file_path);
+		source_file_path =
+			get_output_file_path(file_name, "_viewbinding.c");
+		source_buffer = g_string_new(NULL);
+		output.source_buffer = source_buffer;
+
+		g_string_append_printf(
+			source_buffer,
+			"/* Generated By View Binding Code Generator, Do Not Edit By Hand */\n\n");
+		g_string_append_printf(source_buffer,
+				       "#include <gtk/gtk.h>\n\n");
+		g_string_append_printf(source_buffer, "#include \"%s\"\n",
+				       header_name);
+		if (common_header) {
+			g_string_append_printf(source_buffer,
+					       "#include \"%s\"\n",
+					       common_header_include);
+		} else if (binding_style == BINDING_STYLE_TABLE) {
+			g_string_append_printf(source_buffer, "\n");
+			generate_table_utils_code(source_buffer);
+		}
+	}
+
+	g_string_append_printf(
+		output_buffer,
+		"/* Generated By View Binding Code Generator, Do Not Edit By Hand */\n\n");
+
+	// header guard
+	g_string_append_printf(output_buffer, "#ifndef %s_%s_VIEW_BINDING_H_\n",
+			       application_id, guard_name);
+	g_string_append_printf(output_buffer, "#define %s_%s_VIEW_BINDING_H_\n",
+			       application_id, guard_name);
+	// the registration functions in the source file need no helpers
+	if (source_buffer == NULL && common_header) {
+		g_string_append_printf(output_buffer, "\n#include \"%s\"\n",
+				       common_header_include);
+	} else if (source_buffer == NULL) {
+		g_string_append_printf(output_buffer, "\n");
+		generate_utils_code(output_buffer);
+	} else if (callback_scope) {
+		// the callback macro still expands in the includer
+		g_string_append_printf(output_buffer, "\n");
+		generate_scope_utils_code(output_buffer);
+	}
+
+	// mirror the subdirectory of the UI file in recursive mode, before
+	// stream mode writes the first part
+	const gint64 mkdir_start = g_get_monotonic_time();
+	if (!use_stdio && g_mkdir_with_parents(output_dir_path, 0755) != 0) {
+		g_printerr("Error creating directory %s: %s\n", output_dir_path,
+			   g_strerror(errno));
+		return FALSE;
+	}
+	write_usec = g_get_monotonic_time() - mkdir_start;
+
+	output_writer_init(&header_writer, output_file_path, output_buffer);
+	if (source_buffer)
+		output_writer_init(&source_writer, source_file_path,
+				   source_buffer);
+
+	for (guint i = 0; i < N_PARSERS && written; i++) {
+		ViewBindingParser *parser = &state->parsers[i];
+
+		if (parser->generate_code)
+			parser->generate_code(&output, &parser->user_data);
+		written = output_writer_flush(&header_writer) &&
+			  (source_buffer == NULL ||
+			   output_writer_flush(&source_writer));
+	}
+
+	// end header guard
+	g_string_append_printf(output_buffer,
+			       "\n#endif /* %s_%s_VIEW_BINDING_H_ */\n",
+			       application_id, guard_name);
+
+	file_stats->bytes_out = header_writer.offset + output_buffer->len;
+	if (source_buffer)
+		file_stats->bytes_out += source_writer.offset +
+					 source_buffer->len;
+	written = output_writer_close(&header_writer, written) && written;
+	write_usec += header_writer.write_usec;
+	if (source_buffer) {
+		written = output_writer_close(&source_writer, written) &&
+			  written;
+		write_usec += source_writer.write_usec;
+	}
+	if (minify_ui && written) {
+		minified_file_path = get_output_file_path(file_name, ".min.ui");
+		output_writer_init(&minified_writer, minified_file_path,
+				   state->minified_buffer);
+		file_stats->bytes_out += state->minified_buffer->len;
+		written = output_writer_close(&minified_writer, TRUE);
+		write_usec += minified_writer.write_usec;
+	}
+	file_stats->write_usec = write_usec;
+	file_stats->generate_usec =
+		g_get_monotonic_time() - start_time - write_usec;
+	return written;
+}
+
+static void generate_common_header(void)
+{
+	g_autofree gchar *file_path =
+		g_build_filename(output_directory, COMMON_HEADER_NAME, NULL);
+	g_autoptr(GString) output_buffer = g_string_new(NULL);
+	g_autoptr(GError) error = NULL;
+
+	g_string_append_printf(
+		output_buffer,
+		"/* Generated By View Binding Code Generator, Do Not Edit By Hand */\n\n");
+	g_string_append_printf(output_buffer,
+			       "#ifndef VIEW_BINDING_COMMON_H_\n");
+	g_string_append_printf(output_buffer,
+			       "#define VIEW_BINDING_COMMON_H_\n");
+	g_string_append_printf(output_buffer, "\n");
+	generate_utils_code(output_buffer);
+	g_string_append_printf(output_buffer,
+			       "\n#endif /* VIEW_BINDING_COMMON_H_ */\n");
+
+	if (!write_output_file(file_path, output_buffer, &error)) {
+		g_printerr("Error writing to file %s: %s\n", file_path,
+			   error->message);
+	}
+}
+
+/*
+ * Every generated file depends on its UI file, and the stamp depends on all
+ * of them plus the scanned directories, whose mtime changes when a UI file
+ * is added. Inputs also get empty rules so that deleting a UI file does not
+ * break make.
+ */
+static void generate_depfile(GPtrArray *file_names, GPtrArray *dir_names)
+{
+	g_autoptr(GString) output_buffer = g_string_new(NULL);
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) input_paths =
+		g_ptr_array_new_with_free_func(g_free);
+
+	for (guint i = 0; i < file_names->len; i++) {
+		const gchar *file_name = g_ptr_array_index(file_names, i);
+		g_ptr_array_add(input_paths,
+				g_build_filename(directory, file_name, NULL));
+	}
+
+	append_depfile_path(output_buffer, stamp_file);
+	g_string_append(output_buffer, ":");
+	// explicit inputs do not depend on what else the directory holds
+	if (input_file_names == NULL) {
+		g_string_append(output_buffer, " ");
+		append_depfile_path(output_buffer, directory);
+	}
+	for (guint i = 0; i < dir_names->len; i++) {
+		g_autofree gchar *dir_path = g_build_filename(
+			directory, g_ptr_array_index(dir_names, i), NULL);
+		g_string_append(output_buffer, " \\\n\t");
+		append_depfile_path(output_buffer, dir_path);
+	}
+	for (guint i = 0; i < input_paths->len; i++) {
+		g_string_append(output_buffer, " \\\n\t");
+		append_depfile_path(output_buffer,
+				    g_ptr_array_index(input_paths, i));
+	}
+	g_string_append(output_buffer, "\n");
+
+	for (guint i = 0; i < file_names->len; i++) {
+		const gchar *file_name = g_ptr_array_index(file_names, i);
+		const gchar *input_path = g_ptr_array_index(input_paths, i);
+		g_autofree gchar *header_path =
+			get_output_file_path(file_name, "_viewbinding.h");
+
+		g_string_append(output_buffer, "\n");
+		append_depfile_path(output_buffer, header_path);
+		g_string_append(output_buffer, ": ");
+		append_depfile_path(output_buffer, input_path);
+		g_string_append(output_buffer, "\n");
+		if (emit_source) {
+			g_autofree gchar *source_path = get_output_file_path(
+				file_name, "_viewbinding.c");
+			append_depfile_path(output_buffer, source_path);
+			g_string_append(output_buffer, ": ");
+			append_depfile_path(output_buffer, input_path);
+			g_string_append(output_buffer, "\n");
+		}
+		if (minify_ui) {
+			g_autofree gchar *minified_path =
+				get_output_file_path(file_name, ".min.ui");
+			append_depfile_path(output_buffer, minified_path);
+			g_string_append(output_buffer, ": ");
+			append_depfile_path(output_buffer, input_path);
+			g_string_append(output_buffer, "\n");
+		}
+		append_depfile_path(output_buffer, input_path);
+		g_string_append(output_buffer, ":\n");
+	}
+
+	if (!write_output_file(depfile, output_buffer, &error)) {
+		g_printerr("Error writing to file %s: %s\n", depfile,
+			   error->message);
+		return;
+	}
+
+	// the stamp must always get a new mtime, so skip write_output_file()
+	if (!g_file_set_contents(stamp_file, "", 0, &error)) {
+		g_printerr("Error writing to file %s: %s\n", stamp_file,
+			   error->message);
+	}
+}
+
+static void append_depfile_path(GString *output_buffer, const gchar *path)
+{
+	for (const gchar *p = path; *p != '\0'; p++) {
+		if (*p == ' ' || *p == '#' || *p == '\\')
+			g_string_append_c(output_buffer, '\\');
+		else if (*p == '$')
+			g_string_append_c(output_buffer, '$');
+		g_string_append_c(output_buffer, *p);
+	}
+}
+
+static void generate_utils_code(GString *output_buffer)
+{
+	// add view binding inside utils guard
+	g_string_append_printf(output_buffer,
+			       "#ifndef VIEW_BINDING_INSIDE_UTILS\n");
+	g_string_append_printf(output_buffer,
+			       "#define VIEW_BINDING_INSIDE_UTILS\n");
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(
+		output_buffer,
+		"#define view_binding_full(widget_class, WidgetType, BindingType, binding_name, widget_name, std_widget_name) \\\n");
+	g_string_append_printf(
+		output_buffer,
+		"\tgtk_widget_class_bind_template_child_full(GTK_WIDGET_CLASS(widget_class), #widget_name, FALSE, G_STRUCT_OFFSET(WidgetType, binding_name) + G_STRUCT_OFFSET(BindingType, std_widget_name));\n");
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(
+		output_buffer,
+		"#define view_binding_full_private(widget_class, WidgetType, BindingType, binding_name, widget_name, std_widget_name) \\\n");
+	g_string_append_printf(
+		output_buffer,
+		"\tgtk_widget_class_bind_template_child_full(GTK_WIDGET_CLASS(widget_class), #widget_name, FALSE, G_PRIVATE_OFFSET(WidgetType, binding_name) + G_STRUCT_OFFSET(BindingType, std_widget_name));\n");
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(output_buffer,
+			       "#endif /* VIEW_BINDING_INSIDE_UTILS */\n");
+
+	if (binding_style == BINDING_STYLE_TABLE) {
+		g_string_append_printf(output_buffer, "\n");
+		generate_table_utils_code(output_buffer);
+	}
+	if (callback_scope) {
+		g_string_append_printf(output_buffer, "\n");
+		generate_scope_utils_code(output_buffer);
+	}
+}
+
+static void generate_table_utils_code(GString *output_buffer)
+{
+	// separate guard, headers generated in macro style may come first
+	g_string_append_printf(output_buffer,
+			       "#ifndef VIEW_BINDING_INSIDE_TABLE_UTILS\n");
+	g_string_append_printf(output_buffer,
+			       "#define VIEW_BINDING_INSIDE_TABLE_UTILS\n");
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(output_buffer, "typedef struct {\n");
+	g_string_append_printf(output_buffer, "\tconst char *name;\n");
+	g_string_append_printf(output_buffer, "\tgssize offset;\n");
+	g_string_append_printf(output_buffer, "} ViewBindingEntry;\n");
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(
+		output_buffer,
+		"static inline void view_binding_table_full(GtkWidgetClass *widget_class, const ViewBindingEntry *entries, gsize n_entries, gssize binding_offset)\n");
+	g_string_append_printf(output_buffer, "{\n");
+	g_string_append_printf(output_buffer,
+			       "\tfor (gsize i = 0; i < n_entries; i++)\n");
+	g_string_append_printf(
+		output_buffer,
+		"\t\tgtk_widget_class_bind_template_child_full(widget_class, entries[i].name, FALSE, binding_offset + entries[i].offset);\n");
+	g_string_append_printf(output_buffer, "}\n");
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(output_buffer,
+			       "#endif /* VIEW_BINDING_INSIDE_TABLE_UTILS */\n");
+}
+
+/*
+ * With --callback-scope the template gets a GtkBuilderCScope subclass that
+ * resolves handlers from a static table sorted by name, instead of one hash
+ * insert per handler in class_init and one lookup per signal connection.
+ * Handlers missing from the table go to the parent scope as usual.
+ */
+static void generate_scope_utils_code(GString *output_buffer)
+{
+	g_string_append_printf(
+		output_buffer,
+		"#ifndef VIEW_BINDING_INSIDE_SCOPE_UTILS\n");
+	g_string_append_printf(
+		output_buffer,
+		"#define VIEW_BINDING_INSIDE_SCOPE_UTILS\n");
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(output_buffer, "typedef struct {\n");
+	g_string_append_printf(output_buffer, "\tconst char *name;\n");
+	g_string_append_printf(output_buffer, "\tGCallback callback;\n");
+	g_string_append_printf(output_buffer, "} ViewBindingCallback;\n");
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(output_buffer, "typedef struct {\n");
+	g_string_append_printf(
+		output_buffer,
+		"\tGtkBuilderCScope parent_instance;\n");
+	g_string_append_printf(
+		output_buffer,
+		"\tconst ViewBindingCallback *callbacks;\n");
+	g_string_append_printf(output_buffer, "\tgsize n_callbacks;\n");
+	g_string_append_printf(output_buffer, "} ViewBindingScope;\n");
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(output_buffer, "typedef struct {\n");
+	g_string_append_printf(
+		output_buffer,
+		"\tGtkBuilderCScopeClass parent_class;\n");
+	g_string_append_printf(output_buffer, "} ViewBindingScopeClass;\n");
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(
+		output_buffer,
+		"static GtkBuilderScopeInterface *view_binding_scope_parent_iface;\n");
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(
+		output_buffer,
+		"static inline GClosure *view_binding_scope_create_closure(GtkBuilderScope *builder_scope, GtkBuilder *builder, const char *function_name, GtkBuilderClosureFlags flags, GObject *object, GError **error)\n");
+	g_string_append_printf(output_buffer, "{\n");
+	g_string_append_printf(
+		output_buffer,
+		"\tViewBindingScope *scope = (ViewBindingScope *)builder_scope;\n");
+	g_string_append_printf(output_buffer, "\tgsize low = 0;\n");
+	g_string_append_printf(output_buffer,
+			       "\tgsize high = scope->n_callbacks;\n");
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(output_buffer, "\twhile (low < high) {\n");
+	g_string_append_printf(
+		output_buffer,
+		"\t\tgsize mid = low + (high - low) / 2;\n");
+	g_string_append_printf(
+		output_buffer,
+		"\t\tint cmp = strcmp(function_name, scope->callbacks[mid].name);\n");
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(output_buffer, "\t\tif (cmp == 0) {\n");
+	g_string_append_printf(
+		output_buffer,
+		"\t\t\tGCallback callback = scope->callbacks[mid].callback;\n");
+	g_string_append_printf(
+		output_buffer,
+		"\t\t\tgboolean swapped = (flags & GTK_BUILDER_CLOSURE_SWAPPED) != 0;\n");
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(output_buffer, "\t\t\tif (object)\n");
+	g_string_append_printf(
+		output_buffer,
+		"\t\t\t\treturn swapped ? g_cclosure_new_object_swap(callback, object) : g_cclosure_new_object(callback, object);\n");
+	g_string_append_printf(
+		output_buffer,
+		"\t\t\treturn swapped ? g_cclosure_new_swap(callback, NULL, NULL) : g_cclosure_new(callback, NULL, NULL);\n");
+	g_string_append_printf(output_buffer, "\t\t}\n");
+	g_string_append_printf(output_buffer, "\t\tif (cmp < 0)\n");
+	g_string_append_printf(output_buffer, "\t\t\thigh = mid;\n");
+	g_string_append_printf(output_buffer, "\t\telse\n");
+	g_string_append_printf(output_buffer, "\t\t\tlow = mid + 1;\n");
+	g_string_append_printf(output_buffer, "\t}\n");
+	g_string_append_printf(
+		output_buffer,
+		"\treturn view_binding_scope_parent_iface->create_closure(builder_scope, builder, function_name, flags, object, error);\n");
+	g_string_append_printf(output_buffer, "}\n");
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(
+		output_buffer,
+		"static inline void view_binding_scope_iface_init(gpointer g_iface, gpointer iface_data)\n");
+	g_string_append_printf(output_buffer, "{\n");
+	g_string_append_printf(output_buffer,
+			       "\tGtkBuilderScopeInterface *iface = g_iface;\n");
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(
+		output_buffer,
+		"\tview_binding_scope_parent_iface = g_type_interface_peek_parent(iface);\n");
+	g_string_append_printf(
+		output_buffer,
+		"\tiface->create_closure = view_binding_scope_create_closure;\n");
+	g_string_append_printf(output_buffer, "}\n");
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(
+		output_buffer,
+		"static inline GType view_binding_scope_get_type(void)\n");
+	g_string_append_printf(output_buffer, "{\n");
+	g_string_append_printf(output_buffer, "\tstatic GType type = 0;\n");
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(
+		output_buffer,
+		"\t/* class_init runs under the GType class lock, every header shares the type registered first */\n");
+	g_string_append_printf(output_buffer, "\tif (type == 0)\n");
+	g_string_append_printf(
+		output_buffer,
+		"\t\ttype = g_type_from_name(\"ViewBindingScope\");\n");
+	g_string_append_printf(output_buffer, "\tif (type == 0) {\n");
+	g_string_append_printf(
+		output_buffer,
+		"\t\tconst GInterfaceInfo iface_info = { view_binding_scope_iface_init, NULL, NULL };\n");
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(
+		output_buffer,
+		"\t\ttype = g_type_register_static_simple(GTK_TYPE_BUILDER_CSCOPE, \"ViewBindingScope\", sizeof(ViewBindingScopeClass), NULL, sizeof(ViewBindingScope), NULL, 0);\n");
+	g_string_append_printf(
+		output_buffer,
+		"\t\tg_type_add_interface_static(type, GTK_TYPE_BUILDER_SCOPE, &iface_info);\n");
+	g_string_append_printf(output_buffer, "\t}\n");
+	g_string_append_printf(output_buffer, "\treturn type;\n");
+	g_string_append_printf(output_buffer, "}\n");
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(
+		output_buffer,
+		"static inline void view_binding_set_callback_scope(GtkWidgetClass *widget_class, const ViewBindingCallback *callbacks, gsize n_callbacks)\n");
+	g_string_append_printf(output_buffer, "{\n");
+	g_string_append_printf(
+		output_buffer,
+		"\tViewBindingScope *scope = g_object_new(view_binding_scope_get_type(), NULL);\n");
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(output_buffer,
+			       "\tscope->callbacks = callbacks;\n");
+	g_string_append_printf(
+		output_buffer,
+		"\tscope->n_callbacks = n_callbacks;\n");
+	g_string_append_printf(
+		output_buffer,
+		"\tgtk_widget_class_set_template_scope(widget_class, GTK_BUILDER_SCOPE(scope));\n");
+	g_string_append_printf(output_buffer, "\tg_object_unref(scope);\n");
+	g_string_append_printf(output_buffer, "}\n");
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(
+		output_buffer,
+		"#endif /* VIEW_BINDING_INSIDE_SCOPE_UTILS */\n");
+}
+
+// my_window -> MyWindow, for struct names
+static gchar *get_pascal_string(const gchar *name)
+{
+	g_auto(GStrv) parts = g_strsplit(name, "_", -1);
+
+	for (gchar **part = parts; *part; part++)
+		(*part)[0] = g_ascii_toupper((*part)[0]);
+	return g_strjoinv("", parts);
+}
+
+static gchar *get_base_string(const gchar *file_name)
+{
+	const gchar *slash = strrchr(file_name, G_DIR_SEPARATOR);
+	const gchar *name = slash ? slash + 1 : file_name;
+	const gchar *dot = g_strrstr(name, ".");
+	const gsize len = dot - name;
+
+	GString *base_string = g_string_new_len(name, len);
+	g_string_replace(base_string, "-", "_", -1);
+	g_string_ascii_down(base_string);
+	return g_string_free(base_string, FALSE);
+}
+
+// files in subdirectories get the directory mixed in to stay unique
+static gchar *get_guard_string(const gchar *file_name)
+{
+	g_autofree gchar *base_name = get_base_string(file_name);
+	g_autofree gchar *dir_name = g_path_get_dirname(file_name);
+
+	if (g_strcmp0(dir_name, ".") == 0)
+		return g_steal_pointer(&base_name);
+
+	GString *guard_string = g_string_new(dir_name);
+	for (gsize i = 0; i < guard_string->len; i++) {
+		if (!g_ascii_isalnum(guard_string->str[i]))
+			guard_string->str[i] = '_';
+	}
+	g_string_ascii_down(guard_string);
+	g_string_append_printf(guard_string, "_%s", base_name);
+	return g_string_free(guard_string, FALSE);
+}
+
+// the common header lives at the top of the output directory
+static gchar *get_common_header_include(const gchar *file_name)
+{
+	GString *include = g_string_new(NULL);
+
+	for (const gchar *p = file_name; *p != '\0'; p++) {
+		if (*p == G_DIR_SEPARATOR)
+			g_string_append(include, "../");
+	}
+	g_string_append(include, COMMON_HEADER_NAME);
+	return g_string_free(include, FALSE);
+}
+
+static gchar *get_output_file_path(const gchar *file_name,
+				   const gchar *suffix)
+{
+	g_autofree gchar *base_name = get_base_string(file_name);
+	g_autofree gchar *dir_name = g_path_get_dirname(file_name);
+	g_autofree gchar *output_file_name =
+		g_strconcat(base_name, suffix, NULL);
+
+	if (g_strcmp0(dir_name, ".") == 0)
+		return g_build_filename(output_directory, output_file_name,
+					NULL);
+	return g_build_filename(output_directory, dir_name, output_file_name,
+				NULL);
+}
+
+static void generate_object_code(ViewBindingOutput *output,
+				 gpointer user_data)
+{
+	GString *output_buffer = output->output_buffer;
+	const gchar *base_name = output->base_name;
+	ObjectBindings **object_bindings = (ObjectBindings **)user_data;
+	if (object_bindings == NULL || *object_bindings == NULL)
+		return;
+	GArray *class_id_array = (*object_bindings)->class_ids;
+	guint size = class_id_array->len;
+	if (size == 0) {
+		generate_ensure_types_macro(output_buffer, base_name,
+					    (*object_bindings)->type_names);
+		return;
+	}
+
+	// PascalCase base_name for struct names
+	g_autofree gchar *binding_type = get_pascal_string(base_name);
+	g_autoptr(GStringChunk) members = g_string_chunk_new(256);
+	g_autoptr(GArray) bound_ids = NULL;
+
+	g_string_append_printf(output_buffer, "\n/* Class Bindings */\n");
+	bound_ids = generate_binding_structs(output_buffer, binding_type,
+					     class_id_array, members);
+
+	if (output->source_buffer)
+		generate_binding_source(output, binding_type, bound_ids);
+	else if (binding_style == BINDING_STYLE_TABLE)
+		generate_binding_table(output_buffer, base_name, binding_type,
+				       bound_ids);
+	else
+		generate_binding_macros(output_buffer, base_name, binding_type,
+					bound_ids);
+
+	generate_ensure_types_macro(output_buffer, base_name,
+				    (*object_bindings)->type_names);
+}
+
+/*
+ * --struct-layout nested gives every outermost object with an id and other
+ * bound objects inside it a struct of its own, holding the object and those
+ * inside it. The binding struct embeds it under the object's field name.
+ * Document order already keeps a subtree together, so no member moves.
+ * Returns the objects with their member designators, such as header.title,
+ * as fields.
+ */
+static GArray *generate_binding_structs(GString *output_buffer,
+					const gchar *binding_type,
+					GArray *class_id_array,
+					GStringChunk *members)
+{
+	g_autoptr(GString) binding_struct = NULL;
+	GArray *bound_ids = NULL;
+
+	if (struct_layout == STRUCT_LAYOUT_FLAT) {
+		g_string_append_printf(output_buffer, "typedef struct {\n");
+		for (guint i = 0; i < class_id_array->len; i++) {
+			ClassId *class_id =
+				&g_array_index(class_id_array, ClassId, i);
+			g_string_append_printf(output_buffer, "\t%s *%s;\n",
+					       class_id->class,
+					       class_id->field);
+		}
+		g_string_append_printf(output_buffer, "} %sBinding;\n",
+				       binding_type);
+		return g_array_ref(class_id_array);
+	}
+
+	bound_ids = g_array_sized_new(FALSE, FALSE, sizeof(ClassId),
+				      class_id_array->len);
+	binding_struct = g_string_new(NULL);
+	// groups are runs, the objects of one share the pointer to its field
+	for (guint i = 0, next = 0; i < class_id_array->len; i = next) {
+		const ClassId *first =
+			&g_array_index(class_id_array, ClassId, i);
+		g_autofree gchar *group_type = NULL;
+
+		next = i + 1;
+		while (first->group && next < class_id_array->len &&
+		       g_array_index(class_id_array, ClassId, next).group ==
+			       first->group)
+			next++;
+		if (next - i == 1) {
+			ClassId class_id = *first;
+
+			class_id.group = NULL;
+			g_array_append_val(bound_ids, class_id);
+			g_string_append_printf(binding_struct, "\t%s *%s;\n",
+					       class_id.class, class_id.field);
+			continue;
+		}
+
+		group_type = get_pascal_string(first->group);
+		g_string_append_printf(output_buffer, "typedef struct {\n");
+		for (guint j = i; j < next; j++) {
+			ClassId class_id =
+				g_array_index(class_id_array, ClassId, j);
+			g_autofree gchar *member = g_strconcat(
+				class_id.group, ".", class_id.field, NULL);
+
+			g_string_append_printf(output_buffer, "\t%s *%s;\n",
+					       class_id.class, class_id.field);
+			class_id.field = g_string_chunk_insert(members, member);
+			g_array_append_val(bound_ids, class_id);
+		}
+		g_string_append_printf(output_buffer, "} %s%sBinding;\n\n",
+				       binding_type, group_type);
+		g_string_append_printf(binding_struct, "\t%s%sBinding %s;\n",
+				       binding_type, group_type, first->group);
+	}
+
+	g_string_append_printf(output_buffer,
+			       "typedef struct {\n%s} %sBinding;\n",
+			       binding_struct->str, binding_type);
+	return bound_ids;
+}
+
+/*
+ * One view_binding_full() call per child, expanded at every use of the
+ * macro.
+ */
+static void generate_binding_macros(GString *output_buffer,
+				    const gchar *base_name,
+				    const gchar *binding_type,
+				    GArray *class_id_array)
+{
+	guint size = class_id_array->len;
+
+	// generate view binding macro
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(
+		output_buffer,
+		"#define %s_view_binding(widget_class, WidgetType, binding_name) \\\n",
+		base_name);
+	g_string_append_printf(output_buffer, "\tdo { \\\n");
+	for (int i = 0; i < size; i++) {
+		ClassId *class_id = &g_array_index(class_id_array, ClassId, i);
+		g_string_append_printf(
+			output_buffer,
+			"\t\tview_binding_full(widget_class, WidgetType, %sBinding, binding_name, %s, %s) \\\n",
+			binding_type, class_id->id, class_id->field);
+	}
+	g_string_append_printf(output_buffer, "\t} while(0) \n");
+
+	// generate view binding private macro
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(
+		output_buffer,
+		"#define %s_view_binding_private(widget_class, WidgetType, binding_name) \\\n",
+		base_name);
+	g_string_append_printf(output_buffer, "\tdo { \\\n");
+	for (int i = 0; i < size; i++) {
+		ClassId *class_id = &g_array_index(class_id_array, ClassId, i);
+		g_string_append_printf(
+			output_buffer,
+			"\t\tview_binding_full_private(widget_class, WidgetType, %sBinding, binding_name, %s, %s) \\\n",
+			binding_type, class_id->id, class_id->field);
+	}
+	g_string_append_printf(output_buffer, "\t} while(0) \n");
+}
+
+/*
+ * One static { name, offset } array per binding struct, registered by
+ * view_binding_table_full() in a loop.
+ */
+static void generate_binding_table(GString *output_buffer,
+				   const gchar *base_name,
+				   const gchar *binding_type,
+				   GArray *class_id_array)
+{
+	generate_binding_entries(output_buffer, base_name, binding_type,
+				 class_id_array);
+
+	// generate view binding macro
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(
+		output_buffer,
+		"#define %s_view_binding(widget_class, WidgetType, binding_name) \\\n",
+		base_name);
+	g_string_append_printf(
+		output_buffer,
+		"\tview_binding_table_full(GTK_WIDGET_CLASS(widget_class), %s_view_binding_entries, G_N_ELEMENTS(%s_view_binding_entries), G_STRUCT_OFFSET(WidgetType, binding_name))\n",
+		base_name, base_name);
+
+	// generate view binding private macro
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(
+		output_buffer,
+		"#define %s_view_binding_private(widget_class, WidgetType, binding_name) \\\n",
+		base_name);
+	g_string_append_printf(
+		output_buffer,
+		"\tview_binding_table_full(GTK_WIDGET_CLASS(widget_class), %s_view_binding_entries, G_N_ELEMENTS(%s_view_binding_entries), G_PRIVATE_OFFSET(WidgetType, binding_name))\n",
+		base_name, base_name);
+}
+
+static void generate_binding_entries(GString *output_buffer,
+				     const gchar *base_name,
+				     const gchar *binding_type,
+				     GArray *class_id_array)
+{
+	// generate view binding table
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(
+		output_buffer,
+		"static const ViewBindingEntry %s_view_binding_entries[] = {\n",
+		base_name);
+	for (guint i = 0; i < class_id_array->len; i++) {
+		ClassId *class_id = &g_array_index(class_id_array, ClassId, i);
+		g_string_append_printf(
+			output_buffer,
+			"\t{ \"%s\", G_STRUCT_OFFSET(%sBinding, %s) },\n",
+			class_id->id, binding_type, class_id->field);
+	}
+	g_string_append_printf(output_buffer, "};\n");
+}
+
+/*
+ * The header only declares <base>_view_binding_register(), the body is
+ * compiled once in the source file instead of in every includer.
+ */
+static void generate_binding_source(ViewBindingOutput *output,
+				    const gchar *binding_type,
+				    GArray *class_id_array)
+{
+	GString *output_buffer = output->output_buffer;
+	GString *source_buffer = output->source_buffer;
+	const gchar *base_name = output->base_name;
+
+	// declare the registration function
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(
+		output_buffer,
+		"void %s_view_binding_register(GtkWidgetClass *widget_class, gssize binding_offset);\n",
+		base_name);
+
+	// generate view binding macro
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(
+		output_buffer,
+		"#define %s_view_binding(widget_class, WidgetType, binding_name) \\\n",
+		base_name);
+	g_string_append_printf(
+		output_buffer,
+		"\t%s_view_binding_register(GTK_WIDGET_CLASS(widget_class), G_STRUCT_OFFSET(WidgetType, binding_name))\n",
+		base_name);
+
+	// generate view binding private macro
+	g_string_append_printf(output_buffer, "\n");
+	g_string_append_printf(
+		output_buffer,
+		"#define %s_view_binding_private(widget_class, WidgetType, binding_name) \\\n",
+		base_name);
+	g_string_append_printf(
+		output_buffer,
+		"\t%s_view_binding_register(GTK_WIDGET_CLASS(widget_class), G_PRIVATE_OFFSET(WidgetType, binding_name))\n",
+		base_name);
+
+	// generate the registration function
+	if (binding_style == BINDING_STYLE_TABLE)
+		generate_binding_entries(source_buffer, base_name, binding_type,
+					 class_id_array);
+	g_string_append_printf(source_buffer, "\n");
+	g_string_append_printf(
+		source_buffer,
+		"void %s_view_binding_register(GtkWidgetClass *widget_class, gssize binding_offset)\n",
+		base_name);
+	g_string_append_printf(source_buffer, "{\n");
+	if (binding_style == BINDING_STYLE_TABLE) {
+		g_string_append_printf(
+			source_buffer,
+			"\tview_binding_table_full(widget_class, %s_view_binding_entries, G_N_ELEMENTS(%s_view_binding_entries), binding_offset);\n",
+			base_name, base_name);
+	} else {
+		for (guint i = 0; i < class_id_array->len; i++) {
+			ClassId *class_id =
+				&g_array_index(class_id_array, ClassId, i);
+			g_string_append_printf(
+				source_buffer,
+				"\tgtk_widget_class_bind_template_child_full(widget_class, \"%s\", FALSE, binding_offset + G_STRUCT_OFFSET(%sBinding, %s));\n",
+				class_id->id, binding_type, class_id->field);
+		}
+	}
+	g_string_append_printf(source_buffer, "}\n");
+}
+
+/*
+ * GtkBuilder resolves unregistered types by mangling the class name and
+ * looking up the *_get_type() symbol in the program, registering them all
+ * up front in class_init avoids those lookups. This stays a macro even
+ * with --emit-source so nothing has to link unless it is used.
+ */
+static void generate_ensure_types_macro(GString *output_buffer,
+					const gchar *base_name,
+					GPtrArray *type_names)
+{
+	if (type_names->len == 0)
+		return;
+
+	g_string_append_printf(output_buffer, "\n/* Type Registration */\n");
+	g_string_append_printf(output_buffer,
+			       "#define %s_view_binding_ensure_types() \\\n",
+			       base_name);
+	g_string_append_printf(output_buffer, "\tdo { \\\n");
+	for (guint i = 0; i < type_names->len; i++) {
+		g_autofree gchar *type_function = get_type_function_name(
+			g_ptr_array_index(type_names, i));
+		g_string_append_printf(output_buffer,
+				       "\t\tg_type_ensure(%s()); \\\n",
+				       type_function);
+	}
+	g_string_append_printf(output_buffer, "\t} while(0) \n");
+}
+
+/*
+ * The first mangling GtkBuilder tries, GtkHeaderBar -> gtk_header_bar_get_type.
+ * Like GtkBuilder it takes a character for upper case when upper-casing
+ * leaves it alone, which digits pass as well: GtkGLArea2 ->
+ * gtk_gl_area_2_get_type.
+ */
+static gchar *get_type_function_name(const gchar *type_name)
+{
+	GString *function_name = g_string_new(NULL);
+
+	for (gsize i = 0; type_name[i] != '\0'; i++) {
+		const gchar c = type_name[i];
+		const gboolean upper = is_mangling_upper(c);
+
+		if ((upper && i > 0 && !is_mangling_upper(type_name[i - 1])) ||
+		    (upper && i == 1 && is_mangling_upper(type_name[0])) ||
+		    (upper && i > 2 && is_mangling_upper(type_name[i - 1]) &&
+		     is_mangling_upper(type_name[i - 2])))
+			g_string_append_c(function_name, '_');
+		g_string_append_c(function_name, g_ascii_tolower(c));
+	}
+	g_string_append(function_name, "_get_type");
+	return g_string_free(function_name, FALSE);
+}
+
+static gboolean is_mangling_upper(gchar c)
+{
+	return c == g_ascii_toupper(c);
+}
+
+static void generate_signal_code(ViewBindingOutput *output,
+				 gpointer user_data)
+{
+	GString *output_buffer = output->output_buffer;
+	const gchar *base_name = output->base_name;
+	GArray **signal_array = (GArray **)user_data;
+	if (signal_array == NULL || *signal_array == NULL)
+		return;
+
+	const int size = (*signal_array)->len;
+	if (size == 0)
+		return;
+
+	// a handler used by many widgets only needs to be bound once
+	g_autoptr(GPtrArray) signals = g_ptr_array_sized_new(size);
+	g_autoptr(GHashTable) seen = g_hash_table_new(NULL, NULL);
+	for (int i = 0; i < size; i++) {
+		SignalHandler *signal =
+			&g_array_index(*signal_array, SignalHandler, i);
+		// interned, comparing pointers is enough
+		if (g_hash_table_add(seen, (gpointer)signal->handler))
+			g_ptr_array_add(signals, signal);
+	}
+
+	if (callback_scope) {
+		generate_callback_scope(output_buffer, base_name, signals);
+		return;
+	}
+
+	g_string_append_printf(output_buffer, "\n/* Signal Handlers */\n");
+	g_string_append_printf(
+		output_buffer,
+		"#define %s_view_binding_callback(widget_class) \\\n",
+		base_name);
+	g_string_append_printf(output_buffer, "\tdo { \\\n");
+	for (guint i = 0; i < signals->len; i++) {
+		SignalHandler *signal = g_ptr_array_index(signals, i);
+		g_string_append_printf(
+			output_buffer,
+			"\t\tgtk_widget_class_bind_template_callback_full(GTK_WIDGET_CLASS(widget_class), \"%s\", (GCallback)%s); \\\n",
+			signal->handler, signal->symbol);
+	}
+	g_string_append_printf(output_buffer, "\t} while(0) \n");
+}
+
+/*
+ * The table is declared inside the macro so that it can reference the
+ * handlers, which are usually static functions of the including file.
+ */
+static void generate_callback_scope(GString *output_buffer,
+				    const gchar *base_name, GPtrArray *signals)
+{
+	// same order as strcmp() in view_binding_scope_create_closure()
+	g_ptr_array_sort(signals, compare_signal_handlers);
+
+	g_string_append_printf(output_buffer, "\n/* Signal Handlers */\n");
+	g_string_append_printf(
+		output_buffer,
+		"#define %s_view_binding_callback(widget_class) \\\n",
+		base_name);
+	g_string_append_printf(output_buffer, "\tdo { \\\n");
+	g_string_append_printf(
+		output_buffer,
+		"\t\tstatic const ViewBindingCallback %s_view_binding_callbacks[] = { \\\n",
+		base_name);
+	for (guint i = 0; i < signals->len; i++) {
+		SignalHandler *signal = g_ptr_array_index(signals, i);
+		g_string_append_printf(output_buffer,
+				       "\t\t\t{ \"%s\", (GCallback)%s }, \\\n",
+				       signal->handler, signal->symbol);
+	}
+	g_string_append_printf(output_buffer, "\t\t}; \\\n");
+	g_string_append_printf(
+		output_buffer,
+		"\t\tview_binding_set_callback_scope(GTK_WIDGET_CLASS(widget_class), %s_view_binding_callbacks, G_N_ELEMENTS(%s_view_binding_callbacks)); \\\n",
+		base_name, base_name);
+	g_string_append_printf(output_buffer, "\t} while(0) \n");
+}
+
+static gint compare_signal_handlers(gconstpointer a, gconstpointer b)
+{
+	const SignalHandler *signal_a = *(const SignalHandler **)a;
+	const SignalHandler *signal_b = *(const SignalHandler **)b;
+	return strcmp(signal_a->handler, signal_b->handler);
+}
+
+static gboolean write_output_file(const gchar *file_path,
+				  const GString *content, GError **error)
+{
+	// leave the file and its mtime alone so dependents are not rebuilt
+	if (!always_write && output_file_is_unchanged(file_path, content))
+		return TRUE;
+
+	// without any flag the file is truncated and written in place
+	return g_file_set_contents_full(
+		file_path, content->str, content->len,
+		no_fsync ? G_FILE_SET_CONTENTS_NONE :
+			   G_FILE_SET_CONTENTS_CONSISTENT |
+				   G_FILE_SET_CONTENTS_ONLY_EXISTING,
+		0666, error);
+}
+
+static void output_writer_init(OutputWriter *writer, const gchar *file_path,
+			       GString *buffer)
+{
+	*writer = (OutputWriter){
+		.file_path = use_stdio ? "standard output" : file_path,
+		.buffer = buffer,
+	};
+
+	// a missing or unreadable file simply differs from the first part
+	if (output_mode == OUTPUT_MODE_STREAM && !always_write && !use_stdio)
+		writer->existing = g_mapped_file_new(file_path, FALSE, NULL);
+}
+
+static gboolean output_writer_flush(OutputWriter *writer)
+{
+	g_autoptr(GError) error = NULL;
+	GString *buffer = writer->buffer;
+
+	if (output_mode != OUTPUT_MODE_STREAM || buffer->len == 0)
+		return TRUE;
+
+	const gint64 start_time = g_get_monotonic_time();
+	if (use_stdio) {
+		if (!write_standard_output(buffer, &error)) {
+			g_printerr("Error writing to file %s: %s\n",
+				   writer->file_path, error->message);
+			return FALSE;
+		}
+		writer->offset += buffer->len;
+		g_string_truncate(buffer, 0);
+		writer->write_usec += g_get_monotonic_time() - start_time;
+		return TRUE;
+	}
+	if (writer->stream == NULL && writer->existing &&
+	    writer->offset + buffer->len <=
+		    g_mapped_file_get_length(writer->existing) &&
+	    memcmp(g_mapped_file_get_contents(writer->existing) +
+			   writer->offset,
+		   buffer->str, buffer->len) == 0) {
+		writer->offset += buffer->len;
+		g_string_truncate(buffer, 0);
+		writer->write_usec += g_get_monotonic_time() - start_time;
+		return TRUE;
+	}
+
+	if ((writer->stream == NULL && !output_writer_open(writer, &error)) ||
+	    !g_output_stream_write_all(writer->stream, buffer->str,
+				       buffer->len, NULL, NULL, &error)) {
+		g_printerr("Error writing to file %s: %s\n", writer->file_path,
+			   error->message);
+		return FALSE;
+	}
+	writer->offset += buffer->len;
+	g_string_truncate(buffer, 0);
+	writer->write_usec += g_get_monotonic_time() - start_time;
+	return TRUE;
+}
+
+/*
+ * The bytes before the offset already match, so the file is cut there and
+ * only the rest is written. No temporary file is involved.
+ */
+static gboolean output_writer_open(OutputWriter *writer, GError **error)
+{
+	g_autoptr(GFile) file = g_file_new_for_path(writer->file_path);
+	GError *open_error = NULL;
+
+	// the mapping must go before the file shrinks beneath it
+	g_clear_pointer(&writer->existing, g_mapped_file_unref);
+
+	writer->file_stream = g_file_open_readwrite(file, NULL, &open_error);
+	if (g_error_matches(open_error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND)) {
+		g_clear_error(&open_error);
+		writer->file_stream = g_file_create_readwrite(
+			file, G_FILE_CREATE_NONE, NULL, &open_error);
+	}
+	if (writer->file_stream == NULL) {
+		g_propagate_error(error, open_error);
+		return FALSE;
+	}
+
+	if (!g_seekable_truncate(G_SEEKABLE(writer->file_stream),
+				 writer->offset, NULL, error) ||
+	    !g_seekable_seek(G_SEEKABLE(writer->file_stream), writer->offset,
+			     G_SEEK_SET, NULL, error))
+		return FALSE;
+
+	writer->stream = g_buffered_output_stream_new_sized(
+		g_io_stream_get_output_stream(G_IO_STREAM(writer->file_stream)),
+		64 * 1024);
+	g_filter_output_stream_set_close_base_stream(
+		G_FILTER_OUTPUT_STREAM(writer->stream), FALSE);
+	return TRUE;
+}
+
+/*
+ * Writes what is left unless commit is FALSE, and releases the writer either
+ * way. A file that failed part way is left for the next run to regenerate.
+ */
+static gboolean output_writer_close(OutputWriter *writer, gboolean commit)
+{
+	g_autoptr(GError) error = NULL;
+	gboolean written = TRUE;
+
+	if (commit && output_mode == OUTPUT_MODE_REPLACE) {
+		const gint64 start_time = g_get_monotonic_time();
+		written = use_stdio ? write_standard_output(writer->buffer,
+							    &error) :
+				      write_output_file(writer->file_path,
+							writer->buffer, &error);
+		writer->write_usec += g_get_monotonic_time() - start_time;
+	} else if (commit) {
+		written = output_writer_flush(writer);
+		const gint64 start_time = g_get_monotonic_time();
+
+		// a longer old file, or none at all, still differs at the end
+		if (written && writer->stream == NULL && !use_stdio &&
+		    !(writer->existing &&
+		      g_mapped_file_get_length(writer->existing) ==
+			      writer->offset))
+			written = output_writer_open(writer, &error);
+		if (written && writer->stream)
+			written = g_output_stream_close(writer->stream, NULL,
+							&error) &&
+				  g_io_stream_close(
+					  G_IO_STREAM(writer->file_stream),
+					  NULL, &error);
+		writer->write_usec += g_get_monotonic_time() - start_time;
+	}
+	if (!written && error)
+		g_printerr("Error writing to file %s: %s\n", writer->file_path,
+			   error->message);
+
+	g_clear_pointer(&writer->existing, g_mapped_file_unref);
+	g_clear_object(&writer->stream);
+	g_clear_object(&writer->file_stream);
+	return written;
+}
+
+static gboolean write_standard_output(const GString *content, GError **error)
+{
+	if (fwrite(content->str, 1, content->len, stdout) != content->len ||
+	    fflush(stdout) != 0) {
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+			    "%s", g_strerror(errno));
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static gboolean output_file_is_unchanged(const gchar *file_path,
+					 const GString *content)
+{
+	g_autofree gchar *existing_content = NULL;
+	gsize existing_size = 0;
+	GStatBuf stat_buf;
+
+	if (g_stat(file_path, &stat_buf) != 0 ||
+	    (gsize)stat_buf.st_size != content->len)
+		return FALSE;
+
+	if (!g_file_get_contents(file_path, &existing_content, &existing_size,
+				 NULL))
+		return FALSE;
+
+	return existing_size == content->len &&
+	       memcmp(existing_content, content->str, content->len) == 0;
+}
+
+/*
+ * Options that change the generated code, an entry recorded under other
+ * options is stale.
+ */
+static gchar *get_cache_options(void)
+{
+	GString *options = g_string_new(NULL);
+
+	g_string_append_printf(
+		options,
+		"binding-style=%s;emit-source=%d;common-header=%d;callback-scope=%d",
+		binding_style == BINDING_STYLE_TABLE ? "table" : "macro",
+		emit_source, common_header, callback_scope);
+	// only present when given, so older manifests stay valid
+	for (gchar **pattern = bind_include; pattern && *pattern; pattern++)
+		g_string_append_printf(options, ";bind-include=%s", *pattern);
+	for (gchar **pattern = bind_exclude; pattern && *pattern; pattern++)
+		g_string_append_printf(options, ";bind-exclude=%s", *pattern);
+	if (minify_ui)
+		g_string_append(options, ";minify-ui=1");
+	if (struct_layout == STRUCT_LAYOUT_NESTED)
+		g_string_append(options, ";struct-layout=nested");
+	return g_string_free(options, FALSE);
+}
+
+static void load_cache_manifest(void)
+{
+	g_autofree gchar *manifest_path = NULL;
+	g_autofree gchar *version = NULL;
+	g_autofree gchar *cached_application_id = NULL;
+	g_autofree gchar *cached_options = NULL;
+	g_autofree gchar *options = get_cache_options();
+
+	if (no_cache)
+		return;
+
+	manifest_path = get_manifest_path();
+	cache_manifest = load_manifest_file(manifest_path);
+	// a first shard run starts from the merged manifest, if any
+	if (cache_manifest == NULL && shard_spec) {
+		g_free(manifest_path);
+		manifest_path = g_build_filename(output_directory,
+						 CACHE_MANIFEST_NAME, NULL);
+		cache_manifest = load_manifest_file(manifest_path);
+	}
+	if (cache_manifest == NULL) {
+		cache_manifest = g_key_file_new();
+		return;
+	}
+
+	// entries written by another generator version, for another
+	// application id or with other options describe different output:
+	// start over
+	version = g_key_file_get_string(cache_manifest, CACHE_SETTINGS_GROUP,
+					"version", NULL);
+	cached_application_id = g_key_file_get_string(
+		cache_manifest, CACHE_SETTINGS_GROUP, "application-id", NULL);
+	cached_options = g_key_file_get_string(
+		cache_manifest, CACHE_SETTINGS_GROUP, "options", NULL);
+	if (g_strcmp0(version, VIEW_BINDING_VERSION) != 0 ||
+	    g_strcmp0(cached_application_id, application_id) != 0 ||
+	    g_strcmp0(cached_options, options) != 0) {
+		g_key_file_unref(cache_manifest);
+		cache_manifest = g_key_file_new();
+	}
+}
+
+static void save_cache_manifest(GPtrArray *file_names)
+{
+	g_autoptr(GHashTable) scanned = NULL;
+	g_autoptr(GString) content = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autofree gchar *manifest_path = NULL;
+	g_autofree gchar *data = NULL;
+	g_autofree gchar *options = NULL;
+	g_auto(GStrv) groups = NULL;
+	gsize length = 0;
+
+	if (cache_manifest == NULL)
+		return;
+
+	// drop entries of files that are no longer in the directory, explicit
+	// inputs leave the entries of other files alone
+	scanned = g_hash_table_new(g_str_hash, g_str_equal);
+	for (guint i = 0; i < file_names->len; i++)
+		g_hash_table_add(scanned, g_ptr_array_index(file_names, i));
+	groups = g_key_file_get_groups(cache_manifest, NULL);
+	for (gchar **group = groups; *group && input_file_names == NULL;
+	     group++) {
+		if (g_strcmp0(*group, CACHE_SETTINGS_GROUP) != 0 &&
+		    !g_hash_table_contains(scanned, *group))
+			g_key_file_remove_group(cache_manifest, *group, NULL);
+	}
+
+	g_key_file_set_string(cache_manifest, CACHE_SETTINGS_GROUP, "version",
+			      VIEW_BINDING_VERSION);
+	g_key_file_set_string(cache_manifest, CACHE_SETTINGS_GROUP,
+			      "application-id", application_id);
+	options = get_cache_options();
+	g_key_file_set_string(cache_manifest, CACHE_SETTINGS_GROUP, "options",
+			      options);
+
+	data = g_key_file_to_data(cache_manifest, &length, NULL);
+	content = g_string_new_len(data, length);
+	manifest_path = get_manifest_path();
+	if (!write_output_file(manifest_path, content, &error)) {
+		g_printerr("Error writing to file %s: %s\n", manifest_path,
+			   error->message);
+	} else if (warm_manifests) {
+		keep_warm_manifest(manifest_path);
+	}
+}
+
+/*
+ * Returns NULL when there is no readable manifest. The server takes the
+ * manifest it wrote last instead of parsing it again while the file is still
+ * the one it wrote. The entry is taken out because the run changes the key
+ * file, it comes back when the run saves.
+ */
+static GKeyFile *load_manifest_file(const gchar *manifest_path)
+{
+	g_autoptr(GKeyFile) key_file = NULL;
+
+	if (warm_manifests) {
+		g_autofree gchar *absolute_path =
+			g_canonicalize_filename(manifest_path, NULL);
+		g_autofree gchar *key = NULL;
+		WarmManifest *warm_manifest = NULL;
+		GStatBuf buf;
+
+		if (g_hash_table_steal_extended(warm_manifests, absolute_path,
+						(gpointer *)&key,
+						(gpointer *)&warm_manifest)) {
+			gboolean current =
+				g_stat(manifest_path, &buf) == 0 &&
+				warm_manifest->size == buf.st_size &&
+				warm_manifest->mtime == buf.st_mtime &&
+				warm_manifest->inode == buf.st_ino;
+
+			if (current)
+				key_file = g_key_file_ref(
+					warm_manifest->key_file);
+			free_warm_manifest(warm_manifest);
+			if (current)
+				return g_steal_pointer(&key_file);
+		}
+	}
+
+	key_file = g_key_file_new();
+	if (!g_key_file_load_from_file(key_file, manifest_path,
+				       G_KEY_FILE_NONE, NULL))
+		return NULL;
+	return g_steal_pointer(&key_file);
+}
+
+static void keep_warm_manifest(const gchar *manifest_path)
+{
+	WarmManifest *warm_manifest = NULL;
+	GStatBuf buf;
+
+	if (g_stat(manifest_path, &buf) != 0)
 		return;
 
-	int len = (*signal_array)->len;
-	for (int i = 0; i < len; i++) {
-		gchar *signal = g_array_index(*signal_array, gchar *, i);
-		g_free(signal);
+	warm_manifest = g_new0(WarmManifest, 1);
+	warm_manifest->key_file = g_key_file_ref(cache_manifest);
+	warm_manifest->size = buf.st_size;
+	warm_manifest->mtime = buf.st_mtime;
+	warm_manifest->inode = buf.st_ino;
+	g_hash_table_replace(warm_manifests,
+			     g_canonicalize_filename(manifest_path, NULL),
+			     warm_manifest);
+}
+
+// Each shard keeps its own manifest so shards can share an output directory
+static gchar *get_manifest_path(void)
+{
+	g_autofree gchar *manifest_name = NULL;
+
+	if (shard_spec == NULL)
+		return g_build_filename(output_directory, CACHE_MANIFEST_NAME,
+					NULL);
+
+	manifest_name = g_strdup_printf(CACHE_MANIFEST_NAME ".shard-%u-of-%u",
+					shard_index, shard_count);
+	return g_build_filename(output_directory, manifest_name, NULL);
+}
+
+/*
+ * FNV-1a of the name with '/' separators, so a file lands in the same shard
+ * on every node and platform however the set was discovered.
+ */
+static gboolean file_in_shard(const gchar *file_name)
+{
+	guint32 hash = 2166136261u;
+
+	if (shard_count == 1)
+		return TRUE;
+
+	for (const gchar *p = file_name; *p; p++) {
+		hash ^= (guchar)(*p == G_DIR_SEPARATOR ? '/' : *p);
+		hash *= 16777619u;
 	}
-	g_array_free(*signal_array, TRUE);
+	return hash % shard_count == shard_index;
 }
 
-static void handle_object_attribute(const gchar *element_name,
-				    const gchar **attribute_names,
-				    const gchar **attribute_values,
-				    gpointer user_data)
+/*
+ * Combines the shard manifests into the one a single run over all files
+ * would have written. All shards of one shard count must be present and
+ * agree on the version, application id and options.
+ */
+static gboolean merge_shard_manifests(void)
 {
-	GList **class_id_list = (GList **)user_data;
-	const gchar **cursor_name = attribute_names;
-	const gchar **cursor_value = attribute_values;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GDir) dir = g_dir_open(output_directory, 0, &error);
+	g_autoptr(GKeyFile) merged = g_key_file_new();
+	g_autoptr(GPtrArray) shard_paths = NULL;
+	g_autoptr(GString) content = NULL;
+	g_autofree gchar *settings = NULL;
+	g_autofree gchar *manifest_path = NULL;
+	g_autofree gchar *data = NULL;
+	const gchar *name = NULL;
+	guint count = 0;
+	gsize length = 0;
+
+	if (dir == NULL) {
+		g_printerr("Error opening directory %s: %s\n",
+			   output_directory, error->message);
+		return FALSE;
+	}
 
-	gchar *class_value = NULL;
-	gchar *id_value = NULL;
+	while ((name = g_dir_read_name(dir)) != NULL) {
+		guint index = 0;
+		guint name_count = 0;
+		gchar end = '\0';
 
-	while (cursor_name && *cursor_name) {
-		if (g_strcmp0(*cursor_name, "class") == 0) {
-			class_value = g_strdup(*cursor_value);
-		} else if (g_strcmp0(*cursor_name, "id") == 0) {
-			id_value = g_strdup(*cursor_value);
+		if (!g_str_has_prefix(name, CACHE_MANIFEST_NAME ".shard-") ||
+		    sscanf(name + strlen(CACHE_MANIFEST_NAME ".shard-"),
+			   "%u-of-%u%c", &index, &name_count, &end) != 2 ||
+		    index >= name_count)
+			continue;
+		if (shard_paths == NULL) {
+			count = name_count;
+			shard_paths = g_ptr_array_new_full(count, g_free);
+			g_ptr_array_set_size(shard_paths, count);
+		} else if (name_count != count) {
+			g_printerr(
+				"Error: %s holds manifests of %u and of %u shards, remove the stale ones.\n",
+				output_directory, count, name_count);
+			return FALSE;
 		}
-		cursor_name++;
-		cursor_value++;
+		g_ptr_array_index(shard_paths, index) =
+			g_build_filename(output_directory, name, NULL);
+	}
+	if (shard_paths == NULL) {
+		g_printerr("Error: %s holds no shard manifests.\n",
+			   output_directory);
+		return FALSE;
 	}
 
-	if (class_value && id_value) {
-		ClassId *class_id = g_new0(ClassId, 1);
-		class_id->class = class_value;
-		class_id->id = id_value;
-		*class_id_list = g_list_append(*class_id_list, class_id);
-	} else {
-		if (class_value)
-			g_free(class_value);
-		if (id_value)
-			g_free(id_value);
+	for (guint i = 0; i < count; i++) {
+		const gchar *shard_path = g_ptr_array_index(shard_paths, i);
+		g_autoptr(GKeyFile) shard = g_key_file_new();
+		g_auto(GStrv) groups = NULL;
+		g_autofree gchar *version = NULL;
+		g_autofree gchar *application = NULL;
+		g_autofree gchar *options = NULL;
+		g_autofree gchar *shard_settings = NULL;
+
+		if (shard_path == NULL) {
+			g_printerr(
+				"Error: the manifest of shard %u of %u is missing.\n",
+				i, count);
+			return FALSE;
+		}
+		if (!g_key_file_load_from_file(shard, shard_path,
+					       G_KEY_FILE_NONE, &error)) {
+			g_printerr("Error reading file %s: %s\n", shard_path,
+				   error->message);
+			return FALSE;
+		}
+
+		// every shard must describe the same generator run
+		version = g_key_file_get_value(shard, CACHE_SETTINGS_GROUP,
+					       "version", NULL);
+		application = g_key_file_get_value(shard, CACHE_SETTINGS_GROUP,
+						   "application-id", NULL);
+		options = g_key_file_get_value(shard, CACHE_SETTINGS_GROUP,
+					       "options", NULL);
+		shard_settings = g_strdup_printf("%s;%s;%s", version,
+						 application, options);
+		if (settings == NULL) {
+			settings = g_steal_pointer(&shard_settings);
+		} else if (g_strcmp0(settings, shard_settings) != 0) {
+			g_printerr(
+				"Error: %s was written with other settings than shard 0.\n",
+				shard_path);
+			return FALSE;
+		}
+
+		groups = g_key_file_get_groups(shard, NULL);
+		for (gchar **group = groups; *group; group++) {
+			g_auto(GStrv) keys =
+				g_key_file_get_keys(shard, *group, NULL, NULL);
+			for (gchar **key = keys; key && *key; key++) {
+				g_autofree gchar *value = g_key_file_get_value(
+					shard, *group, *key, NULL);
+				g_key_file_set_value(merged, *group, *key,
+						     value);
+			}
+		}
+	}
+
+	data = g_key_file_to_data(merged, &length, NULL);
+	content = g_string_new_len(data, length);
+	manifest_path = g_build_filename(output_directory, CACHE_MANIFEST_NAME,
+					 NULL);
+	if (!write_output_file(manifest_path, content, &error)) {
+		g_printerr("Error writing to file %s: %s\n", manifest_path,
+			   error->message);
+		return FALSE;
 	}
+	return TRUE;
 }
 
-static void handle_signal_attribute(const gchar *element_name,
-				    const gchar **attribute_names,
-				    const gchar **attribute_values,
-				    gpointer user_data)
+static gboolean query_input_file(const gchar *file_path, guint64 *size,
+				 guint64 *mtime)
 {
-	GArray **signal_array = (GArray **)user_data;
-	const gchar **cursor_name = attribute_names;
-	const gchar **cursor_value = attribute_values;
+	g_autoptr(GFile) file = g_file_new_for_path(file_path);
+	g_autoptr(GFileInfo) info = g_file_query_info(
+		file,
+		G_FILE_ATTRIBUTE_STANDARD_SIZE
+		"," G_FILE_ATTRIBUTE_TIME_MODIFIED
+		"," G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+		G_FILE_QUERY_INFO_NONE, NULL, NULL);
 
-	gchar *signal_value = NULL;
+	if (info == NULL)
+		return FALSE;
 
-	while (cursor_name && *cursor_name) {
-		if (g_strcmp0(*cursor_name, "handler") == 0) {
-			signal_value = g_strdup(*cursor_value);
-			break;
+	*size = g_file_info_get_size(info);
+	*mtime = g_file_info_get_attribute_uint64(
+			 info, G_FILE_ATTRIBUTE_TIME_MODIFIED) *
+			 G_USEC_PER_SEC +
+		 g_file_info_get_attribute_uint32(
+			 info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+	return TRUE;
+}
+
+/*
+ * An entry is fresh when the recorded size matches and either the mtime
+ * (checksum == NULL) or the content checksum matches, and the files it
+ * produced still exist.
+ */
+static gboolean cache_entry_is_fresh(const gchar *file_name, guint64 size,
+				     guint64 mtime, const gchar *checksum)
+{
+	g_autofree gchar *output_file_path = NULL;
+	g_autofree gchar *source_file_path = NULL;
+	g_autofree gchar *minified_file_path = NULL;
+	g_autofree gchar *cached_checksum = NULL;
+	gboolean fresh = FALSE;
+
+	if (cache_manifest == NULL)
+		return FALSE;
+
+	g_mutex_lock(&cache_lock);
+	if (g_key_file_has_group(cache_manifest, file_name) &&
+	    g_key_file_get_uint64(cache_manifest, file_name, "size", NULL) ==
+		    size) {
+		if (checksum == NULL) {
+			fresh = g_key_file_get_uint64(cache_manifest, file_name,
+						      "mtime", NULL) == mtime;
+		} else {
+			cached_checksum = g_key_file_get_string(
+				cache_manifest, file_name, "sha256", NULL);
+			fresh = g_strcmp0(cached_checksum, checksum) == 0;
 		}
-		cursor_name++;
-		cursor_value++;
 	}
+	g_mutex_unlock(&cache_lock);
 
-	if (signal_value) {
-		if (*signal_array == NULL) {
-			*signal_array =
-				g_array_new(FALSE, FALSE, sizeof(gchar *));
+	if (!fresh)
+		return FALSE;
+
+	output_file_path = get_output_file_path(file_name, "_viewbinding.h");
+	if (!g_file_test(output_file_path, G_FILE_TEST_IS_REGULAR))
+		return FALSE;
+	if (emit_source) {
+		source_file_path =
+			get_output_file_path(file_name, "_viewbinding.c");
+		if (!g_file_test(source_file_path, G_FILE_TEST_IS_REGULAR))
+			return FALSE;
+	}
+	if (minify_ui) {
+		minified_file_path = get_output_file_path(file_name, ".min.ui");
+		if (!g_file_test(minified_file_path, G_FILE_TEST_IS_REGULAR))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static void cache_entry_update(const gchar *file_name, guint64 size,
+			       guint64 mtime, const gchar *checksum)
+{
+	if (cache_manifest == NULL || checksum == NULL)
+		return;
+
+	// group names cannot hold brackets or line breaks
+	if (strpbrk(file_name, "[]\n\r") != NULL)
+		return;
+
+	g_mutex_lock(&cache_lock);
+	g_key_file_set_uint64(cache_manifest, file_name, "size", size);
+	g_key_file_set_uint64(cache_manifest, file_name, "mtime", mtime);
+	g_key_file_set_string(cache_manifest, file_name, "sha256", checksum);
+	g_mutex_unlock(&cache_lock);
+}
+
+static void cache_entry_remove(const gchar *file_name)
+{
+	if (cache_manifest == NULL)
+		return;
+
+	g_mutex_lock(&cache_lock);
+	g_key_file_remove_group(cache_manifest, file_name, NULL);
+	g_mutex_unlock(&cache_lock);
+}
+
+// The sub-struct names index_group_structs() claimed for the file
+static gchar **cache_entry_get_structs(const gchar *file_name)
+{
+	gchar **structs = NULL;
+
+	if (cache_manifest == NULL)
+		return NULL;
+
+	g_mutex_lock(&cache_lock);
+	if (g_key_file_has_group(cache_manifest, file_name))
+		structs = g_key_file_get_string_list(
+			cache_manifest, file_name, "structs", NULL, NULL);
+	g_mutex_unlock(&cache_lock);
+	return structs;
+}
+
+static void cache_entry_set_structs(const gchar *file_name, gchar **structs)
+{
+	if (cache_manifest == NULL)
+		return;
+
+	// only entries cache_entry_update() wrote
+	g_mutex_lock(&cache_lock);
+	if (g_key_file_has_group(cache_manifest, file_name) && structs)
+		g_key_file_set_string_list(cache_manifest, file_name,
+					   "structs",
+					   (const gchar *const *)structs,
+					   g_strv_length(structs));
+	else if (g_key_file_has_group(cache_manifest, file_name))
+		g_key_file_remove_key(cache_manifest, file_name, "structs",
+				      NULL);
+	g_mutex_unlock(&cache_lock);
+}
+
+/*
+ * Returns input itself when it has no hyphen, otherwise an arena copy with
+ * the hyphens replaced by underscores.
+ */
+static const gchar *arena_insert_identifier(GStringChunk *arena,
+					    const gchar *input)
+{
+	if (strchr(input, '-') == NULL)
+		return input;
+
+	gchar *output = g_string_chunk_insert(arena, input);
+	for (gchar *p = output; *p != '\0'; p++) {
+		if (*p == '-') {
+			*p = '_';
 		}
-		g_array_append_val(*signal_array, signal_value);
 	}
+	return output;
 }
 
-static void generate_code(GHashTable *view_binding_parser_map,
-			  const gchar *file_name)
+static void record_file_stats(const FileStats *file_stats)
 {
-	const gchar *dot = g_strrstr(file_name, ".");
-	const gsize len = dot - file_name;
+	FileStats copy = *file_stats;
 
-	g_autofree gchar *base_name = g_strndup(file_name, len);
-	g_autoptr(GString) base_string = g_string_new(base_name);
-	g_string_replace(base_string, "-", "_", -1);
-	g_string_ascii_down(base_string);
+	copy.file_name = g_strdup(file_stats->file_name);
+	g_mutex_lock(&stats_lock);
+	g_array_append_val(run_stats.files, copy);
+	g_mutex_unlock(&stats_lock);
+}
 
-	g_autofree gchar *output_file_name =
-		g_strconcat(base_string->str, "_viewbinding.h", NULL);
-	g_autofree gchar *output_file_path =
-		g_build_filename(output_directory, output_file_name, NULL);
-	g_autoptr(GError) error = NULL;
+// slowest first
+static gint compare_file_stats(gconstpointer a, gconstpointer b)
+{
+	const FileStats *stats_a = (const FileStats *)a;
+	const FileStats *stats_b = (const FileStats *)b;
+	return (stats_a->total_usec < stats_b->total_usec) -
+	       (stats_a->total_usec > stats_b->total_usec);
+}
+
+/*
+ * The per-file phases are summed over all files, with --jobs they run in
+ * parallel and may add up to more than the wall time.
+ */
+static void print_stats(void)
+{
+	FileStats total = { 0 };
+	guint unchanged = 0;
+	guint top = 0;
 
-	// check and free output_buffer
-	if (output_buffer) {
-		g_string_free(output_buffer, TRUE);
-		output_buffer = NULL;
+	g_array_sort(run_stats.files, compare_file_stats);
+	for (guint i = 0; i < run_stats.files->len; i++) {
+		FileStats *file_stats =
+			&g_array_index(run_stats.files, FileStats, i);
+		total.read_usec += file_stats->read_usec;
+		total.parse_usec += file_stats->parse_usec;
+		total.generate_usec += file_stats->generate_usec;
+		total.write_usec += file_stats->write_usec;
+		total.objects += file_stats->objects;
+		total.signals += file_stats->signals;
+		total.bytes_in += file_stats->bytes_in;
+		total.bytes_out += file_stats->bytes_out;
+		if (file_stats->unchanged)
+			unchanged++;
 	}
 
-	output_buffer = g_string_new(NULL);
-	g_string_append_printf(
-		output_buffer,
-		"/* Generated By View Binding Code Generator, Do Not Edit By Hand */\n\n");
+	g_print("viewbinding: %u files, %u unchanged, %.3f ms with %d jobs\n",
+		run_stats.files->len, unchanged, run_stats.wall_usec / 1000.0,
+		jobs);
+	g_print("  %-10s %12.3f ms\n", "scan", run_stats.scan_usec / 1000.0);
+	g_print("  %-10s %12.3f ms\n", "cache", run_stats.cache_usec / 1000.0);
+	g_print("  %-10s %12.3f ms\n", "read", total.read_usec / 1000.0);
+	g_print("  %-10s %12.3f ms\n", "parse", total.parse_usec / 1000.0);
+	g_print("  %-10s %12.3f ms\n", "generate",
+		total.generate_usec / 1000.0);
+	g_print("  %-10s %12.3f ms\n", "write", total.write_usec / 1000.0);
+	if (depfile)
+		g_print("  %-10s %12.3f ms\n", "depfile",
+			run_stats.depfile_usec / 1000.0);
+	g_print("  %u objects, %u signals, %" G_GUINT64_FORMAT
+		" bytes in, %" G_GUINT64_FORMAT " bytes out\n",
+		total.objects, total.signals, total.bytes_in, total.bytes_out);
 
-	// header guard
-	g_string_append_printf(output_buffer, "#ifndef %s_%s_VIEW_BINDING_H_\n",
-			       application_id, base_string->str);
-	g_string_append_printf(output_buffer, "#define %s_%s_VIEW_BINDING_H_\n",
-			       application_id, base_string->str);
-	g_string_append_printf(output_buffer, "\n");
+	top = MIN((guint)stats_top, run_stats.files->len);
+	if (top == 0)
+		return;
+	g_print("slowest files:\n");
+	g_print("  %10s %8s %8s %10s %10s  %s\n", "ms", "objects", "signals",
+		"bytes in", "bytes out", "file");
+	for (guint i = 0; i < top; i++) {
+		FileStats *file_stats =
+			&g_array_index(run_stats.files, FileStats, i);
+		g_print("  %10.3f %8u %8u %10" G_GUINT64_FORMAT
+			" %10" G_GUINT64_FORMAT "  %s%s\n",
+			file_stats->total_usec / 1000.0, file_stats->objects,
+			file_stats->signals, file_stats->bytes_in,
+			file_stats->bytes_out, file_stats->file_name,
+			file_stats->unchanged ? " (unchanged)" : "");
+	}
+}
 
-	// add view binding inside utils guard
+// every file is listed, slowest first, times are in microseconds
+static void write_stats_json(void)
+{
+	g_autoptr(GString) output_buffer = g_string_new(NULL);
+	g_autoptr(GError) error = NULL;
+
+	g_array_sort(run_stats.files, compare_file_stats);
+
+	g_string_append(output_buffer, "{\n");
+	g_string_append_printf(output_buffer, "  \"version\": \"%s\",\n",
+			       VIEW_BINDING_VERSION);
+	g_string_append_printf(output_buffer, "  \"jobs\": %d,\n", jobs);
 	g_string_append_printf(output_buffer,
-			       "#ifndef VIEW_BINDING_INSIDE_UTILS\n");
+			       "  \"wall_usec\": %" G_GINT64_FORMAT ",\n",
+			       run_stats.wall_usec);
 	g_string_append_printf(output_buffer,
-			       "#define VIEW_BINDING_INSIDE_UTILS\n");
-	g_string_append_printf(output_buffer, "\n");
-	g_string_append_printf(
-		output_buffer,
-		"#define view_binding_full(widget_class, WidgetType, BindingType, binding_name, widget_name, std_widget_name) \\\n");
-	g_string_append_printf(
-		output_buffer,
-		"\tgtk_widget_class_bind_template_child_full(GTK_WIDGET_CLASS(widget_class), #widget_name, FALSE, G_STRUCT_OFFSET(WidgetType, binding_name) + G_STRUCT_OFFSET(BindingType, std_widget_name));\n");
-	g_string_append_printf(output_buffer, "\n");
-	g_string_append_printf(
-		output_buffer,
-		"#define view_binding_full_private(widget_class, WidgetType, BindingType, binding_name, widget_name, std_widget_name) \\\n");
-	g_string_append_printf(
-		output_buffer,
-		"\tgtk_widget_class_bind_template_child_full(GTK_WIDGET_CLASS(widget_class), #widget_name, FALSE, G_PRIVATE_OFFSET(WidgetType, binding_name) + G_STRUCT_OFFSET(BindingType, std_widget_name));\n");
-	g_string_append_printf(output_buffer, "\n");
+			       "  \"scan_usec\": %" G_GINT64_FORMAT ",\n",
+			       run_stats.scan_usec);
 	g_string_append_printf(output_buffer,
-			       "#endif /* VIEW_BINDING_INSIDE_UTILS */\n");
-
-	g_hash_table_foreach(view_binding_parser_map, hash_table_for_each,
-			     base_string->str);
-
-	// end header guard
+			       "  \"cache_usec\": %" G_GINT64_FORMAT ",\n",
+			       run_stats.cache_usec);
 	g_string_append_printf(output_buffer,
-			       "\n#endif /* %s_%s_VIEW_BINDING_H_ */\n",
-			       application_id, base_string->str);
+			       "  \"depfile_usec\": %" G_GINT64_FORMAT ",\n",
+			       run_stats.depfile_usec);
+	g_string_append(output_buffer, "  \"files\": [");
+	for (guint i = 0; i < run_stats.files->len; i++) {
+		FileStats *file_stats =
+			&g_array_index(run_stats.files, FileStats, i);
 
-	g_file_set_contents(output_file_path, output_buffer->str,
-			    output_buffer->len, &error);
-	if (error) {
-		g_printerr("Error writing to file %s: %s\n", output_file_name,
+		g_string_append(output_buffer, i == 0 ? "\n" : ",\n");
+		g_string_append(output_buffer, "    { \"file\": ");
+		append_json_string(output_buffer, file_stats->file_name);
+		g_string_append_printf(
+			output_buffer,
+			", \"unchanged\": %s, \"total_usec\": %" G_GINT64_FORMAT
+			", \"read_usec\": %" G_GINT64_FORMAT
+			", \"parse_usec\": %" G_GINT64_FORMAT
+			", \"generate_usec\": %" G_GINT64_FORMAT
+			", \"write_usec\": %" G_GINT64_FORMAT
+			", \"objects\": %u, \"signals\": %u"
+			", \"bytes_in\": %" G_GUINT64_FORMAT
+			", \"bytes_out\": %" G_GUINT64_FORMAT " }",
+			file_stats->unchanged ? "true" : "false",
+			file_stats->total_usec, file_stats->read_usec,
+			file_stats->parse_usec, file_stats->generate_usec,
+			file_stats->write_usec, file_stats->objects,
+			file_stats->signals, file_stats->bytes_in,
+			file_stats->bytes_out);
+	}
+	g_string_append(output_buffer,
+			run_stats.files->len > 0 ? "\n  ]\n}\n" : "]\n}\n");
+
+	if (!g_file_set_contents(stats_json, output_buffer->str,
+				 output_buffer->len, &error)) {
+		g_printerr("Error writing to file %s: %s\n", stats_json,
 			   error->message);
 	}
+}
 
-	g_string_free(output_buffer, TRUE);
-	output_buffer = NULL;
+static void append_json_string(GString *output_buffer, const gchar *value)
+{
+	g_string_append_c(output_buffer, '"');
+	for (const gchar *p = value; *p != '\0'; p++) {
+		if (*p == '"' || *p == '\\')
+			g_string_append_printf(output_buffer, "\\%c", *p);
+		else if ((guchar)*p < 0x20)
+			g_string_append_printf(output_buffer, "\\u%04x",
+					       (guchar)*p);
+		else
+			g_string_append_c(output_buffer, *p);
+	}
+	g_string_append_c(output_buffer, '"');
 }
 
-static void generate_object_code(const gchar *base_name, gpointer user_data)
+static void clear_file_stats(FileStats *file_stats)
 {
-	GList **class_id_list = (GList **)user_data;
-	if (class_id_list == NULL || *class_id_list == NULL)
-		return;
-	guint size = g_list_length(*class_id_list);
-	if (size == 0)
-		return;
+	g_free(file_stats->file_name);
+}
 
-	// change base_name to PascalCase for struct name
-	gchar **sp = g_strsplit_set(base_name, "_", -1);
-	g_autoptr(GString) name_builder = g_string_new(NULL);
-	guint name_size = g_strv_length(sp);
-	for (guint i = 0; i < name_size; i++) {
-		gchar *part = sp[i];
-		if (part && part[0] != '\0') {
-			if (g_ascii_islower(part[0])) {
-				part[0] = g_ascii_toupper(part[0]);
-			}
-			g_string_append(name_builder, part);
-		}
-	}
-	g_strfreev(sp);
+static AllocPhase enter_alloc_phase(AllocPhase phase)
+{
+#ifdef HAVE_ALLOC_STATS
+	const AllocPhase previous = alloc_phase;
 
-	g_string_append_printf(output_buffer, "\n/* Class Bindings */\n");
-	// generate view binding struct
-	g_string_append_printf(output_buffer, "typedef struct {\n");
-	for (int i = 0; i < size; i++) {
-		ClassId *class_id =
-			(ClassId *)g_list_nth_data(*class_id_list, i);
-		g_autofree gchar *underline_name = replace_hyphen_to_underscore_dup(
-			class_id->id);
-		g_string_append_printf(output_buffer, "\t%s *%s;\n",
-				       class_id->class, underline_name);
+	alloc_phase = phase;
+	return previous;
+#else
+	return phase;
+#endif
+}
+
+static gboolean start_alloc_accounting(void)
+{
+#ifdef HAVE_ALLOC_STATS
+	memset(alloc_counters, 0, sizeof(alloc_counters));
+	live_blocks = 0;
+	live_bytes = 0;
+	peak_live_bytes = 0;
+	// held from an earlier --server request, destroyed during this one
+	g_mutex_lock(&parser_states_lock);
+	parser_data_created = count_parser_data();
+	parser_data_destroyed = 0;
+	g_mutex_unlock(&parser_states_lock);
+	g_atomic_int_set(&alloc_accounting, TRUE);
+	return TRUE;
+#else
+	return FALSE;
+#endif
+}
+
+/*
+ * Frees what the run still holds first, the parser state of this thread
+ * included, so that what is left after teardown is kept by GLib (interned
+ * names, types, thread data) or by worker threads, which free their parser
+ * state when they exit. Fails when parser user_data was neither destroyed
+ * nor is still held by a worker.
+ */
+static gboolean print_alloc_stats(void)
+{
+	static const gchar *const phase_names[N_ALLOC_PHASES] = {
+		[ALLOC_PHASE_OTHER] = "other",
+		[ALLOC_PHASE_READ] = "read",
+		[ALLOC_PHASE_PARSE] = "parse",
+		[ALLOC_PHASE_ATTRIBUTES] = "attributes",
+		[ALLOC_PHASE_GENERATE] = "generate",
+	};
+	AllocCounter counters[N_ALLOC_PHASES];
+	AllocCounter total = { 0 };
+	gssize blocks_left = 0;
+	gssize bytes_left = 0;
+	glong peak_rss = 0;
+	gint created = 0;
+	gint destroyed = 0;
+	gint held = 0;
+
+	g_private_replace(&view_binding_state, NULL);
+	g_clear_pointer(&cache_manifest, g_key_file_unref);
+	g_clear_pointer(&symbol_index, g_hash_table_unref);
+	g_clear_pointer(&run_stats.files, g_array_unref);
+
+	g_mutex_lock(&parser_states_lock);
+	held = count_parser_data();
+	created = g_atomic_int_get(&parser_data_created);
+	destroyed = g_atomic_int_get(&parser_data_destroyed);
+	g_mutex_unlock(&parser_states_lock);
+
+	// the report allocates as well
+	g_atomic_int_set(&alloc_accounting, FALSE);
+	memcpy(counters, alloc_counters, sizeof(counters));
+	blocks_left = __atomic_load_n(&live_blocks, __ATOMIC_SEQ_CST);
+	bytes_left = __atomic_load_n(&live_bytes, __ATOMIC_SEQ_CST);
+#ifdef HAVE_ALLOC_STATS
+	{
+		struct rusage usage;
+
+		if (getrusage(RUSAGE_SELF, &usage) == 0)
+			peak_rss = usage.ru_maxrss;
 	}
-	g_string_append_printf(output_buffer, "} %sBinding;\n",
-			       name_builder->str);
+#endif
 
-	// generate view binding macro
-	g_string_append_printf(output_buffer, "\n");
-	g_string_append_printf(
-		output_buffer,
-		"#define %s_view_binding(widget_class, WidgetType, binding_name) \\\n",
-		base_name);
-	g_string_append_printf(output_buffer, "\tdo { \\\n");
-	for (int i = 0; i < size; i++) {
-		ClassId *class_id =
-			(ClassId *)g_list_nth_data(*class_id_list, i);
-		g_autofree gchar *underline_name = replace_hyphen_to_underscore_dup(
-			class_id->id);
-		g_string_append_printf(
-			output_buffer,
-			"\t\tview_binding_full(widget_class, WidgetType, %sBinding, binding_name, %s, %s) \\\n",
-			name_builder->str, class_id->id, underline_name);
+	for (guint i = 0; i < N_ALLOC_PHASES; i++) {
+		total.count += counters[i].count;
+		total.bytes += counters[i].bytes;
 	}
-	g_string_append_printf(output_buffer, "\t} while(0) \n");
+	g_print("viewbinding: %" G_GSIZE_FORMAT " allocations, %" G_GSIZE_FORMAT
+		" bytes with %d jobs\n",
+		total.count, total.bytes, jobs);
+	for (guint i = 0; i < N_ALLOC_PHASES; i++)
+		g_print("  %-10s %12" G_GSIZE_FORMAT
+			" allocs %14" G_GSIZE_FORMAT " bytes\n",
+			phase_names[i], counters[i].count, counters[i].bytes);
+	g_print("  peak heap %" G_GSSIZE_FORMAT
+		" bytes above the start, peak RSS %ld KiB\n",
+		peak_live_bytes, peak_rss);
+	g_print("  parser data: %d created, %d destroyed, %d held by workers\n",
+		created, destroyed, held);
+	g_print("  after teardown: %" G_GSSIZE_FORMAT
+		" blocks, %" G_GSSIZE_FORMAT " bytes still allocated\n",
+		blocks_left, bytes_left);
 
-	// generate view binding private macro
-	g_string_append_printf(output_buffer, "\n");
-	g_string_append_printf(
-		output_buffer,
-		"#define %s_view_binding_private(widget_class, WidgetType, binding_name) \\\n",
-		base_name);
-	g_string_append_printf(output_buffer, "\tdo { \\\n");
-	for (int i = 0; i < size; i++) {
-		ClassId *class_id =
-			(ClassId *)g_list_nth_data(*class_id_list, i);
-		g_autofree gchar *underline_name = replace_hyphen_to_underscore_dup(
-			class_id->id);
-		g_string_append_printf(
-			output_buffer,
-			"\t\tview_binding_full_private(widget_class, WidgetType, %sBinding, binding_name, %s, %s) \\\n",
-			name_builder->str, class_id->id, underline_name);
+	if (created != destroyed + held) {
+		g_printerr("Error: %d parser states were not destroyed.\n",
+			   created - destroyed - held);
+		return FALSE;
 	}
-	g_string_append_printf(output_buffer, "\t} while(0) \n");
+	return TRUE;
 }
 
-static void generate_signal_code(const gchar *base_name, gpointer user_data)
+// Called with parser_states_lock held, while no file is being parsed
+static gint count_parser_data(void)
 {
-	GArray **signal_array = (GArray **)user_data;
-	if (signal_array == NULL || *signal_array == NULL)
-		return;
+	gint held = 0;
 
-	const int size = (*signal_array)->len;
-	if (size == 0)
-		return;
-	g_string_append_printf(output_buffer, "\n/* Signal Handlers */\n");
-	g_string_append_printf(
-		output_buffer,
-		"#define %s_view_binding_callback(widget_class) \\\n",
-		base_name);
-	g_string_append_printf(output_buffer, "\tdo { \\\n");
-	for (int i = 0; i < size; i++) {
-		gchar *signal = g_array_index(*signal_array, gchar *, i);
-		g_autofree gchar *underline_signal =
-			replace_hyphen_to_underscore_dup(signal);
-		g_string_append_printf(
-			output_buffer,
-			"\t\tgtk_widget_class_bind_template_callback_full(GTK_WIDGET_CLASS(widget_class), \"%s\", (GCallback)%s); \\\n",
-			signal, underline_signal);
+	for (guint i = 0; parser_states && i < parser_states->len; i++) {
+		ViewBindingState *state = g_ptr_array_index(parser_states, i);
+
+		for (guint j = 0; j < N_PARSERS; j++)
+			if (state->parsers[j].user_data)
+				held++;
 	}
-	g_string_append_printf(output_buffer, "\t} while(0) \n");
+	return held;
 }
 
-static void hash_table_for_each(gpointer key, gpointer value,
-				gpointer user_data)
+#ifdef HAVE_ALLOC_STATS
+/*
+ * The malloc family replaced for --alloc-stats, forwarding to glibc's own
+ * under its __libc_ names. Blocks are counted with their usable size, which
+ * free() can look up again, so they need no header.
+ */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *pointer, size_t size);
+extern void __libc_free(void *pointer);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void *__libc_valloc(size_t size);
+extern void *__libc_pvalloc(size_t size);
+
+static void count_allocation(void *pointer, gsize old_size, gboolean new_block)
 {
-	ViewBindingParser *parser = (ViewBindingParser *)value;
-	const gchar *base_name = user_data;
+	AllocCounter *counter = &alloc_counters[alloc_phase];
+	const gsize size = malloc_usable_size(pointer);
+	const gssize growth = (gssize)size - (gssize)old_size;
+	gssize live = 0;
+	gssize peak = 0;
 
-	if (parser && parser->generate_code)
-		parser->generate_code(base_name, &parser->user_data);
+	__atomic_fetch_add(&counter->count, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&counter->bytes, size, __ATOMIC_RELAXED);
+	if (new_block)
+		__atomic_fetch_add(&live_blocks, 1, __ATOMIC_RELAXED);
+	live = __atomic_add_fetch(&live_bytes, growth, __ATOMIC_RELAXED);
+	peak = __atomic_load_n(&peak_live_bytes, __ATOMIC_RELAXED);
+	while (live > peak &&
+	       !__atomic_compare_exchange_n(&peak_live_bytes, &peak, live,
+					    TRUE, __ATOMIC_RELAXED,
+					    __ATOMIC_RELAXED))
+		;
 }
 
-static gchar *replace_hyphen_to_underscore_dup(const gchar *input)
+static void count_free(void *pointer)
 {
-	gchar *output = g_strdup(input);
+	__atomic_fetch_sub(&live_blocks, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_sub(&live_bytes, (gssize)malloc_usable_size(pointer),
+			   __ATOMIC_RELAXED);
+}
 
-	for (gchar *p = output; *p != '\0'; p++) {
-		if (*p == '-') {
-			*p = '_';
-		}
+static void *count_new_block(void *pointer)
+{
+	if (pointer && g_atomic_int_get(&alloc_accounting))
+		count_allocation(pointer, 0, TRUE);
+	return pointer;
+}
+
+void *malloc(size_t size)
+{
+	return count_new_block(__libc_malloc(size));
+}
+
+void *calloc(size_t count, size_t size)
+{
+	return count_new_block(__libc_calloc(count, size));
+}
+
+void *realloc(void *pointer, size_t size)
+{
+	gsize old_size = 0;
+	void *new_pointer = NULL;
+
+	if (!g_atomic_int_get(&alloc_accounting))
+		return __libc_realloc(pointer, size);
+
+	old_size = pointer ? malloc_usable_size(pointer) : 0;
+	new_pointer = __libc_realloc(pointer, size);
+	if (new_pointer)
+		count_allocation(new_pointer, old_size, pointer == NULL);
+	else if (pointer && size == 0) {
+		// freed, as glibc does for a size of 0
+		__atomic_fetch_sub(&live_blocks, 1, __ATOMIC_RELAXED);
+		__atomic_fetch_sub(&live_bytes, (gssize)old_size,
+				   __ATOMIC_RELAXED);
 	}
-	return output;
+	return new_pointer;
+}
+
+void free(void *pointer)
+{
+	if (pointer && g_atomic_int_get(&alloc_accounting))
+		count_free(pointer);
+	__libc_free(pointer);
+}
+
+int posix_memalign(void **pointer, size_t alignment, size_t size)
+{
+	void *block = NULL;
+
+	if (alignment == 0 || alignment % sizeof(void *) != 0 ||
+	    (alignment & (alignment - 1)) != 0)
+		return EINVAL;
+	block = count_new_block(__libc_memalign(alignment, size));
+	if (block == NULL)
+		return ENOMEM;
+	*pointer = block;
+	return 0;
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+	return count_new_block(__libc_memalign(alignment, size));
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+	return count_new_block(__libc_memalign(alignment, size));
+}
+
+void *valloc(size_t size)
+{
+	return count_new_block(__libc_valloc(size));
+}
+
+void *pvalloc(size_t size)
+{
+	return count_new_block(__libc_pvalloc(size));
 }
+#endif
@@ -5,8 +5,26 @@ set_project("viewbinding")
 -- add requirements
 add_requires("glib-2.0", {alias = "glib2", system = true})
 
+-- replaces malloc to count allocations for --alloc-stats
+option("alloc-stats", function (option)
+    set_default(false)
+    set_showmenu(true)
+    set_description("Support --alloc-stats by replacing the glibc malloc")
+    add_defines("VIEW_BINDING_ALLOC_STATS")
+end)
+
 target("viewbinding", function (target)
     add_rules("module.binary")
     add_files("main.c")
     add_packages("glib2")
-end)
\ No newline at end of file
+    add_options("alloc-stats")
+end)
+
+target("bench", function (target)
+    add_rules("module.binary")
+    set_basename("viewbinding-bench")
+    set_default(false)
+    add_deps("viewbinding")
+    add_files("bench/bench.c")
+    add_packages("glib2")
+end)